@@ -1,12 +1,78 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "blas/copy.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace blas {
 
+//
+//  Alignment of every buffer handed out by the allocators below:
+//  a cache line, and the width of an AVX-512 register
+//
+constexpr size_t alignment = 64;
+
+//
+//  Buffers handed out by the allocators below, over all threads; a loop
+//  that reuses its workspaces leaves the count unchanged
+//  Counting costs an atomic add per allocation, so it is compiled in only
+//  with BLAS_COUNT_ALLOCATIONS defined, and allocations() exists only then
+//
+#ifdef BLAS_COUNT_ALLOCATIONS
+inline
+std::atomic<size_t>&
+_allocations()
+{
+    static std::atomic<size_t> count(0);
+    return count;
+}
+
+inline
+size_t
+allocations()
+{
+    return _allocations().load(std::memory_order_relaxed);
+}
+#endif
+
+inline
+void
+_count_allocation()
+{
+#ifdef BLAS_COUNT_ALLOCATIONS
+    _allocations().fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+inline
+void*
+aligned_allocate(size_t bytes)
+{
+    return operator new(bytes, std::align_val_t(alignment));
+}
+
+inline
+void
+aligned_deallocate(void* ptr)
+{
+    operator delete(ptr, std::align_val_t(alignment));
+}
+
 //
 //  Defult allocator similar to std::allocator
-//  Uses operator new and operator delete for memory management
+//  Uses aligned operator new and operator delete for memory management
 //
 template <typename T>
 class allocator{
@@ -20,45 +86,638 @@ public:
     allocate(size_t size)
     {
         if (size == 0) return nullptr;
-        return reinterpret_cast<T*>(operator new(size * sizeof(T)));
+        _count_allocation();
+        return reinterpret_cast<T*>(aligned_allocate(size * sizeof(T)));
     }
 
     static
     void
     deallocate(T* ptr)
     {
-        operator delete(ptr);
+        if (ptr) aligned_deallocate(ptr);
+    }
+};
+
+//
+//  Size-class pool of aligned blocks with a free list per thread
+//  Block sizes are powers of two from 64 bytes to 1 MiB; a 64 byte header in
+//  front of every block records its class, so deallocation needs no size and
+//  a block may be released on any thread. Each thread keeps a bounded number
+//  of free blocks per class, within a byte budget, and hands the rest back to
+//  operator delete; larger buffers are allocated at their exact size and
+//  never cached
+//
+class memory_pool
+{
+public:
+
+    static constexpr size_t header = alignment;
+    static constexpr size_t classes = 15;                   // largest pooled block is 1 MiB
+    static constexpr size_t max_cached = 16;                // free blocks kept per class and thread
+    static constexpr size_t max_cached_bytes = 8u << 20;    // free bytes kept per thread
+
+    static
+    void*
+    allocate(size_t bytes)
+    {
+        const size_t size_class = _size_class(bytes + header);
+
+        void* block = nullptr;
+        if (size_class < classes and _state != state::destroyed)
+            block = _local().pop(size_class);
+
+        if (!block)
+            block = aligned_allocate(size_class < classes ? _class_bytes(size_class) : bytes + header);
+
+        *static_cast<size_t*>(block) = size_class;
+        return static_cast<char*>(block) + header;
+    }
+
+    static
+    void
+    deallocate(void* ptr)
+    {
+        if (!ptr) return;
+
+        void* block = static_cast<char*>(ptr) - header;
+        const size_t size_class = *static_cast<size_t*>(block);
+
+        // after the thread's cache is gone (static destructors) blocks go straight back
+        if (size_class < classes and _state != state::destroyed and _local().push(size_class, block))
+            return;
+
+        aligned_deallocate(block);
+    }
+
+private:
+
+    enum class state : unsigned char { fresh, alive, destroyed };
+
+    static inline thread_local state _state = state::fresh;
+
+    struct cache
+    {
+        void* blocks[classes][max_cached];
+        size_t count[classes] = {};
+        size_t bytes = 0;
+
+        cache()
+        {
+            _state = state::alive;
+        }
+
+        ~cache()
+        {
+            for (size_t c = 0; c < classes; ++c)
+                while (count[c])
+                    aligned_deallocate(blocks[c][--count[c]]);
+
+            _state = state::destroyed;
+        }
+
+        void*
+        pop(size_t size_class)
+        {
+            if (count[size_class] == 0) return nullptr;
+
+            bytes -= _class_bytes(size_class);
+            return blocks[size_class][--count[size_class]];
+        }
+
+        bool
+        push(size_t size_class, void* block)
+        {
+            if (count[size_class] == max_cached) return false;
+            if (bytes + _class_bytes(size_class) > max_cached_bytes) return false;
+
+            bytes += _class_bytes(size_class);
+            blocks[size_class][count[size_class]++] = block;
+            return true;
+        }
+    };
+
+    static
+    cache&
+    _local()
+    {
+        static thread_local cache local;
+        return local;
+    }
+
+    static
+    size_t
+    _class_bytes(size_t size_class)
+    {
+        return alignment << size_class;
+    }
+
+    static
+    size_t
+    _size_class(size_t bytes)
+    {
+        size_t size_class = 0;
+        while (size_class < classes and _class_bytes(size_class) < bytes)
+            ++size_class;
+        return size_class;
     }
 };
 
+//
+//  64 byte aligned allocator recycling buffers through memory_pool
+//  Default allocator of vector and matrix: training frees and reallocates
+//  the same few sizes for every sample
+//
 template <typename T>
-class stack_allocator {
-        
-    stack_allocator() {};
-    
+class pool_allocator {
+
+    pool_allocator() {}
+
+public:
+
+    static
+    T*
+    allocate(size_t size)
+    {
+        if (size == 0) return nullptr;
+        _count_allocation();
+        return reinterpret_cast<T*>(memory_pool::allocate(size * sizeof(T)));
+    }
+
+    static
+    void
+    deallocate(T* ptr)
+    {
+        memory_pool::deallocate(ptr);
+    }
+};
+
+//
+//  Buffers on transparent huge pages
+//  Buffers of huge_page_threshold bytes and more are mapped with mmap at a
+//  2 MiB boundary and marked MADV_HUGEPAGE, so that a large weight matrix
+//  takes one TLB entry per 2 MiB instead of per 4 KiB. The kernel may still
+//  back them with small pages (THP disabled, no free huge page); granted()
+//  tells how much of a buffer actually got huge pages. Smaller buffers, and
+//  every buffer off Linux, come from memory_pool
+//  A 64 byte header in front of each buffer records how it was obtained
+//
+class huge_pages
+{
+public:
+
+    static constexpr size_t page = size_t(1) << 21;
+    static constexpr size_t threshold = size_t(1) << 22;
+    static constexpr size_t header = alignment;
+
+    static
+    void*
+    allocate(size_t bytes)
+    {
+#ifdef __linux__
+        if (bytes >= threshold)
+            if (void* ptr = _map(bytes))
+                return ptr;
+#endif
+        char* ptr = static_cast<char*>(memory_pool::allocate(bytes + header)) + header;
+        *_header(ptr) = { nullptr, 0 };
+        return ptr;
+    }
+
+    static
+    void
+    deallocate(void* ptr)
+    {
+        if (!ptr) return;
+
+        const mapping m = *_header(ptr);
+#ifdef __linux__
+        if (m.base)
+        {
+            munmap(m.base, m.length);
+            return;
+        }
+#endif
+        memory_pool::deallocate(static_cast<char*>(ptr) - header);
+    }
+
+    //
+    //  Bytes of the buffer at ptr backed by huge pages, read from
+    //  /proc/self/smaps; pages are only granted once they are first written
+    //  smaps counts per VMA, and the kernel may merge neighbouring mappings
+    //  into one, so the figure is capped at the buffer's own mapping but may
+    //  include huge pages of a merged neighbour up to that size
+    //
+    static
+    size_t
+    granted(const void* ptr)
+    {
+        size_t bytes = 0;
+#ifdef __linux__
+        if (!ptr or !_header(ptr)->base) return 0;
+
+        std::FILE* smaps = std::fopen("/proc/self/smaps", "r");
+        if (!smaps) return 0;
+
+        const uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+        bool inside = false;
+        char line[256];
+        while (std::fgets(line, sizeof(line), smaps))
+        {
+            unsigned long begin, end, kb;
+            if (std::sscanf(line, "%lx-%lx ", &begin, &end) == 2)
+                inside = begin <= address and address < end;
+            else if (inside and std::sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+            {
+                bytes = size_t(kb) << 10;
+                if (bytes > _header(ptr)->length)
+                    bytes = _header(ptr)->length;
+                break;
+            }
+        }
+        std::fclose(smaps);
+#endif
+        return bytes;
+    }
+
+private:
+
+    struct mapping
+    {
+        void* base;
+        size_t length;
+    };
+
+    static
+    mapping*
+    _header(const void* ptr)
+    {
+        return reinterpret_cast<mapping*>(const_cast<char*>(static_cast<const char*>(ptr)) - header);
+    }
+
+#ifdef __linux__
+    //
+    //  Maps enough to place the data at a 2 MiB boundary after a small page
+    //  for the header, then unmaps the slack on both sides
+    //
+    static
+    void*
+    _map(size_t bytes)
+    {
+        const size_t small_page = size_t(sysconf(_SC_PAGESIZE));
+        const size_t length = (bytes + page - 1) / page * page;
+        const size_t reserved = length + page + small_page;
+
+        void* reservation = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reservation == MAP_FAILED) return nullptr;
+
+        char* const first = static_cast<char*>(reservation);
+        char* const data = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(first) + small_page + page - 1) / page * page);
+        char* const base = data - small_page;
+
+        if (base > first)
+            munmap(first, base - first);
+        if (first + reserved > data + length)
+            munmap(data + length, first + reserved - (data + length));
+
+        // advice only, the buffer is usable either way
+        madvise(data, length, MADV_HUGEPAGE);
+
+        *_header(data) = { base, length + small_page };
+        return data;
+    }
+#endif
+};
+
+//
+//  Allocator for large matrices, see huge_pages
+//
+template <typename T>
+class huge_page_allocator {
+
+    huge_page_allocator() {}
+
+public:
+
+    static
+    T*
+    allocate(size_t size)
+    {
+        if (size == 0) return nullptr;
+        _count_allocation();
+        return reinterpret_cast<T*>(huge_pages::allocate(size * sizeof(T)));
+    }
+
+    static
+    void
+    deallocate(T* ptr)
+    {
+        huge_pages::deallocate(ptr);
+    }
+};
+
+//
+//  Bump-pointer arena for buffers that all die together, such as the
+//  scratch vectors of one training step
+//  Allocation advances an offset inside the current block and moves on to
+//  the next block (allocating it if needed) when the request does not fit.
+//  Nothing is freed individually; reset() or a frame going out of scope
+//  rewinds the arena, and a reset that needed several blocks replaces them
+//  with one block of their combined size so the next step stays in one block
+//
+class arena
+{
+    struct block
+    {
+        char* data;
+        size_t size;
+    };
+
+    block* _blocks;
+    size_t _count, _capacity;       // blocks owned, slots in _blocks
+    size_t _current, _offset;       // bump position
+    size_t _block_size;
+    size_t _frames;                 // frames open on the arena
+
+public:
+
+    //
+    //  Saved position of the arena; destroying a frame releases
+    //  everything allocated after it was created
+    //
+    class frame
+    {
+        arena& _arena;
+        size_t _current, _offset;
+
+    public:
+
+        explicit
+        frame(arena& a = arena::local())
+        :   _arena(a),
+            _current(a._current),
+            _offset(a._offset)
+        {
+            ++_arena._frames;
+        }
+
+        frame(const frame&) = delete;
+        frame& operator = (const frame&) = delete;
+
+        ~frame()
+        {
+            --_arena._frames;
+
+            if (_current == 0 and _offset == 0)
+                _arena.reset();
+            else
+                _arena._rewind(_current, _offset);
+        }
+    };
+
+    explicit
+    arena(size_t block_size = 1 << 20)
+    :   _blocks(nullptr),
+        _count(0),
+        _capacity(0),
+        _current(0),
+        _offset(0),
+        _block_size(block_size),
+        _frames(0)
+    {}
+
+    arena(const arena&) = delete;
+    arena& operator = (const arena&) = delete;
+
+    ~arena()
+    {
+        _release();
+    }
+
+    //
+    //  Arena of the calling thread, used by arena_allocator
+    //
+    static
+    arena&
+    local()
+    {
+        static thread_local arena a;
+        return a;
+    }
+
+    void*
+    allocate(size_t bytes)
+    {
+        bytes = (bytes + alignment - 1) / alignment * alignment;
+
+        while (_current < _count)
+        {
+            if (_offset + bytes <= _blocks[_current].size)
+            {
+                void* ptr = _blocks[_current].data + _offset;
+                _offset += bytes;
+                return ptr;
+            }
+
+            ++_current;
+            _offset = 0;
+        }
+
+        _grow(bytes > _block_size ? bytes : _block_size);
+        _current = _count - 1;
+        _offset = bytes;
+        return _blocks[_current].data;
+    }
+
+    //
+    //  Releases every allocation at once
+    //
+    void
+    reset()
+    {
+        if (_count > 1)
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < _count; ++i)
+                total += _blocks[i].size;
+
+            _release();
+            _grow(total);
+        }
+
+        _current = 0;
+        _offset = 0;
+    }
+
+    //
+    //  Whether a frame is open, i.e. whether anything will release
+    //  what is allocated now
+    //
+    bool
+    in_frame() const
+    {
+        return _frames > 0;
+    }
+
+    //
+    //  Whether ptr points into one of the arena's blocks
+    //
+    bool
+    owns(const void* ptr) const
+    {
+        const char* p = static_cast<const char*>(ptr);
+        for (size_t i = 0; i < _count; ++i)
+            if (p >= _blocks[i].data and p < _blocks[i].data + _blocks[i].size)
+                return true;
+        return false;
+    }
+
+    //
+    //  Bytes held from the system
+    //
+    size_t
+    capacity() const
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < _count; ++i)
+            total += _blocks[i].size;
+        return total;
+    }
+
+private:
+
+    void
+    _rewind(size_t current, size_t offset)
+    {
+        _current = current;
+        _offset = offset;
+    }
+
+    void
+    _grow(size_t size)
+    {
+        if (_count == _capacity)
+        {
+            const size_t capacity = _capacity ? _capacity * 2 : 4;
+            block* blocks = static_cast<block*>(operator new(capacity * sizeof(block)));
+            for (size_t i = 0; i < _count; ++i)
+                blocks[i] = _blocks[i];
+
+            operator delete(_blocks);
+            _blocks = blocks;
+            _capacity = capacity;
+        }
+
+        _blocks[_count++] = { static_cast<char*>(aligned_allocate(size)), size };
+    }
+
+    void
+    _release()
+    {
+        for (size_t i = 0; i < _count; ++i)
+            aligned_deallocate(_blocks[i].data);
+
+        operator delete(_blocks);
+        _blocks = nullptr;
+        _count = 0;
+        _capacity = 0;
+    }
+};
+
+//
+//  Allocator drawing from the calling thread's arena
+//  Inside an arena::frame, buffers are released only when the frame ends,
+//  so containers using it must not outlive that frame; outside any frame
+//  nothing would release them, so they come from the pool instead and are
+//  freed one by one as usual
+//
+template <typename T>
+class arena_allocator {
+
+    arena_allocator() {}
+
 public:
 
-    static 
+    static
     T*
     allocate(size_t size)
     {
         if (size == 0) return nullptr;
-        return alloca(size * sizeof(T));
+
+        arena& a = arena::local();
+        if (!a.in_frame())
+            return pool_allocator<T>::allocate(size);
+
+        _count_allocation();
+        return reinterpret_cast<T*>(a.allocate(size * sizeof(T)));
+    }
+
+    static
+    void
+    deallocate(T* ptr)
+    {
+        if (ptr and !arena::local().owns(ptr))
+            pool_allocator<T>::deallocate(ptr);
+    }
+};
+
+//
+//  Allocator tag giving vector an inline buffer of N elements
+//  Vectors of up to N elements live inside the vector object itself,
+//  larger ones are served by the fallback allocator
+//
+template <typename T, size_t N, typename _fallback = pool_allocator<T>>
+class small_allocator {
+
+    small_allocator() {}
+
+public:
+
+    static constexpr size_t inline_capacity = N;
+
+    static
+    T*
+    allocate(size_t size)
+    {
+        return _fallback::allocate(size);
+    }
+
+    static
+    void
+    deallocate(T* ptr)
+    {
+        _fallback::deallocate(ptr);
     }
+};
 
-    static 
-    void 
-    deallocate(T* ptr) {}
+//
+//  Number of elements a container keeps inline for a given allocator
+//
+template <typename _alloc>
+struct inline_capacity
+{
+    static constexpr size_t value = 0;
+};
 
+template <typename T, size_t N, typename _fallback>
+struct inline_capacity<small_allocator<T, N, _fallback>>
+{
+    static constexpr size_t value = N;
 };
 
+//
+//  Copies size elements, converting when the types differ; same-type
+//  copies go through kernel::copy
+//
 template <typename T1, typename T2>
 void
 memcpy(T1* dest, const T2* src, size_t size)
 {
-    for (size_t i = 0; i < size; ++i)
+    if constexpr (std::is_same<T1, T2>::value)
     {
-        *dest++ = *src++;
+        kernel::copy(size, src, dest);
+    } else {
+        for (size_t i = 0; i < size; ++i)
+            dest[i] = src[i];
     }
 }
 
@@ -66,9 +725,9 @@ template <typename T>
 void
 swap(T& x, T& y)
 {
-    const T temp = x;
-    x = y;
-    y = x;
+    T temp = std::move(x);
+    x = std::move(y);
+    y = std::move(temp);
 }
 
 }
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstddef>
+
+#ifdef BLAS_USE_CBLAS
+#include <cblas.h>
+#endif
+
+namespace blas {
+namespace external {
+
+//
+//  Optional CBLAS backend for float and double GEMV, GEMM and GER, compiled
+//  in with BLAS_USE_CBLAS (the NEURAL_USE_CBLAS CMake option)
+//  Every call returns false when it does not take the product: the backend
+//  is absent or disabled, T is not float or double, or the strides have no
+//  CBLAS equivalent; the kernel entry points then run the built-in kernels
+//
+
+constexpr bool available =
+#ifdef BLAS_USE_CBLAS
+    true;
+#else
+    false;
+#endif
+
+inline
+bool&
+_enabled()
+{
+    static bool enabled = available;
+    return enabled;
+}
+
+//
+//  Switches between the external library and the built-in kernels at run time,
+//  e.g. to compare them; has no effect when the backend is not compiled in
+//
+inline
+void
+enable(bool on)
+{
+    _enabled() = on and available;
+}
+
+inline
+bool
+enabled()
+{
+    return _enabled();
+}
+
+// Generic fallbacks //////////////////////////////////////////////////////
+
+template <typename T>
+bool
+gemv(size_t, size_t, const T*, size_t, const T*, T*)
+{
+    return false;
+}
+
+template <typename T>
+bool
+gemv_t(size_t, size_t, const T*, size_t, const T*, T*)
+{
+    return false;
+}
+
+template <typename T>
+bool
+ger(size_t, size_t, T, const T*, const T*, T*, size_t)
+{
+    return false;
+}
+
+template <typename T>
+bool
+gemm(size_t, size_t, size_t, const T*, size_t, size_t, const T*, size_t, size_t, T, T*, size_t)
+{
+    return false;
+}
+
+#ifdef BLAS_USE_CBLAS
+
+// CBLAS //////////////////////////////////////////////////////////////////
+
+//
+//  Maps a strided operand to a row-major CBLAS one: unit column stride
+//  is NoTrans, unit row stride is the transpose of a row-major matrix
+//
+inline
+bool
+_operand(size_t rows, size_t columns, size_t rs, size_t cs, CBLAS_TRANSPOSE& trans, size_t& ld)
+{
+    if (cs == 1 and rs >= columns)
+    {
+        trans = CblasNoTrans;
+        ld = rs;
+        return true;
+    }
+    if (rs == 1 and cs >= rows)
+    {
+        trans = CblasTrans;
+        ld = cs;
+        return true;
+    }
+    return false;
+}
+
+inline
+bool
+gemv(size_t m, size_t n, const float* a, size_t lda, const float* x, float* y)
+{
+    if (!enabled() or m == 0 or n == 0) return false;
+    cblas_sgemv(CblasRowMajor, CblasNoTrans, m, n, 1.0f, a, lda, x, 1, 0.0f, y, 1);
+    return true;
+}
+
+inline
+bool
+gemv(size_t m, size_t n, const double* a, size_t lda, const double* x, double* y)
+{
+    if (!enabled() or m == 0 or n == 0) return false;
+    cblas_dgemv(CblasRowMajor, CblasNoTrans, m, n, 1.0, a, lda, x, 1, 0.0, y, 1);
+    return true;
+}
+
+inline
+bool
+gemv_t(size_t m, size_t n, const float* a, size_t lda, const float* x, float* y)
+{
+    if (!enabled() or m == 0 or n == 0) return false;
+    cblas_sgemv(CblasRowMajor, CblasTrans, m, n, 1.0f, a, lda, x, 1, 0.0f, y, 1);
+    return true;
+}
+
+inline
+bool
+gemv_t(size_t m, size_t n, const double* a, size_t lda, const double* x, double* y)
+{
+    if (!enabled() or m == 0 or n == 0) return false;
+    cblas_dgemv(CblasRowMajor, CblasTrans, m, n, 1.0, a, lda, x, 1, 0.0, y, 1);
+    return true;
+}
+
+inline
+bool
+ger(size_t m, size_t n, float alpha, const float* x, const float* y, float* a, size_t lda)
+{
+    if (!enabled() or m == 0 or n == 0) return false;
+    cblas_sger(CblasRowMajor, m, n, alpha, x, 1, y, 1, a, lda);
+    return true;
+}
+
+inline
+bool
+ger(size_t m, size_t n, double alpha, const double* x, const double* y, double* a, size_t lda)
+{
+    if (!enabled() or m == 0 or n == 0) return false;
+    cblas_dger(CblasRowMajor, m, n, alpha, x, 1, y, 1, a, lda);
+    return true;
+}
+
+inline
+bool
+gemm(
+    size_t m, size_t n, size_t k,
+    const float* a, size_t rsa, size_t csa,
+    const float* b, size_t rsb, size_t csb,
+    float beta, float* c, size_t ldc
+)
+{
+    CBLAS_TRANSPOSE ta, tb;
+    size_t lda, ldb;
+
+    if (!enabled() or m == 0 or n == 0 or k == 0) return false;
+    if (!_operand(m, k, rsa, csa, ta, lda) or !_operand(k, n, rsb, csb, tb, ldb)) return false;
+
+    cblas_sgemm(CblasRowMajor, ta, tb, m, n, k, 1.0f, a, lda, b, ldb, beta, c, ldc);
+    return true;
+}
+
+inline
+bool
+gemm(
+    size_t m, size_t n, size_t k,
+    const double* a, size_t rsa, size_t csa,
+    const double* b, size_t rsb, size_t csb,
+    double beta, double* c, size_t ldc
+)
+{
+    CBLAS_TRANSPOSE ta, tb;
+    size_t lda, ldb;
+
+    if (!enabled() or m == 0 or n == 0 or k == 0) return false;
+    if (!_operand(m, k, rsa, csa, ta, lda) or !_operand(k, n, rsb, csb, tb, ldb)) return false;
+
+    cblas_dgemm(CblasRowMajor, ta, tb, m, n, k, 1.0, a, lda, b, ldb, beta, c, ldc);
+    return true;
+}
+
+#endif // BLAS_USE_CBLAS
+
+} // namespace external
+} // namespace blas
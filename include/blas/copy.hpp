@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "blas/cpu.hpp"
+#include "blas/thread_pool.hpp"
+
+#ifdef BLAS_X86
+#include <emmintrin.h>
+#endif
+
+namespace blas {
+namespace kernel {
+
+//
+//  Bulk copy and fill behind the containers
+//  Trivially copyable elements go through std::memcpy / std::memset, others
+//  are assigned one by one; buffers of streaming_bytes and more are written
+//  with non-temporal stores, which bypass the cache, so copying a large
+//  weight matrix does not evict the working set
+//
+
+// bytes from which copies and fills stream past the cache
+constexpr size_t streaming_bytes = size_t(1) << 23;
+
+// bytes per task of a parallel copy or fill
+constexpr size_t copy_grain = size_t(1) << 20;
+
+#ifdef BLAS_X86
+
+// Non-temporal stores ////////////////////////////////////////////////////
+
+//
+//  SSE2 is part of x86-64, so these need no dispatch; the stores are
+//  bound by memory bandwidth, not by the vector width
+//  Heads and tails up to the 16 byte boundaries use plain memcpy
+//
+inline
+void
+stream_copy(char* dst, const char* src, size_t bytes)
+{
+    const size_t head = std::min(bytes, (16 - reinterpret_cast<uintptr_t>(dst) % 16) % 16);
+    std::memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    bytes -= head;
+
+    for (; bytes >= 64; bytes -= 64, dst += 64, src += 64)
+    {
+        const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+        const __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst), v0);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), v1);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), v2);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), v3);
+    }
+    for (; bytes >= 16; bytes -= 16, dst += 16, src += 16)
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+
+    std::memcpy(dst, src, bytes);
+
+    // streaming stores are weakly ordered, publish them before returning
+    _mm_sfence();
+}
+
+//
+//  Writes a 16 byte pattern; dst must be aligned so that the pattern
+//  starts at an element boundary, which holds for element sizes dividing 16
+//
+inline
+void
+stream_fill(char* dst, const char* pattern, size_t bytes)
+{
+    const size_t head = std::min(bytes, (16 - reinterpret_cast<uintptr_t>(dst) % 16) % 16);
+    std::memcpy(dst, pattern, head);
+    dst += head;
+    bytes -= head;
+
+    // the pattern seen from the aligned address
+    alignas(16) char rotated[16];
+    for (size_t i = 0; i < 16; ++i)
+        rotated[i] = pattern[(head + i) % 16];
+    const __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(rotated));
+
+    for (; bytes >= 64; bytes -= 64, dst += 64)
+    {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst), v);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), v);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), v);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), v);
+    }
+    for (; bytes >= 16; bytes -= 16, dst += 16)
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst), v);
+
+    std::memcpy(dst, rotated, bytes);
+
+    _mm_sfence();
+}
+
+#endif // BLAS_X86
+
+// Copy ///////////////////////////////////////////////////////////////////
+
+//
+//  dst[i] = src[i] for n elements, the ranges must not overlap
+//
+template <typename T>
+void
+copy(size_t n, const T* src, T* dst)
+{
+    if (n == 0 or src == dst) return;
+
+    if constexpr (std::is_trivially_copyable<T>::value)
+    {
+        const size_t bytes = n * sizeof(T);
+        const char* s = reinterpret_cast<const char*>(src);
+        char* d = reinterpret_cast<char*>(dst);
+
+#ifdef BLAS_X86
+        if (bytes >= streaming_bytes)
+        {
+            parallel_for(0, bytes, copy_grain, [=](size_t begin, size_t end)
+            {
+                stream_copy(d + begin, s + begin, end - begin);
+            });
+            return;
+        }
+#endif
+        parallel_for(0, bytes, copy_grain, [=](size_t begin, size_t end)
+        {
+            std::memcpy(d + begin, s + begin, end - begin);
+        });
+    } else {
+        parallel_for(0, n, grain::elementwise, [=](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                dst[i] = src[i];
+        });
+    }
+}
+
+// Fill ///////////////////////////////////////////////////////////////////
+
+template <typename T>
+bool
+_is_byte_pattern(const T& value)
+{
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+
+    for (size_t i = 1; i < sizeof(T); ++i)
+        if (bytes[i] != bytes[0])
+            return false;
+    return true;
+}
+
+//
+//  dst[i] = value for n elements
+//
+template <typename T>
+void
+fill(size_t n, const T& value, T* dst)
+{
+    if (n == 0) return;
+
+    if constexpr (std::is_trivially_copyable<T>::value)
+    {
+        const size_t bytes = n * sizeof(T);
+        char* d = reinterpret_cast<char*>(dst);
+
+#ifdef BLAS_X86
+        if constexpr (16 % sizeof(T) == 0)
+        {
+            if (bytes >= streaming_bytes)
+            {
+                char pattern[16];
+                for (size_t i = 0; i < 16; i += sizeof(T))
+                    std::memcpy(pattern + i, &value, sizeof(T));
+
+                parallel_for(0, n, copy_grain / sizeof(T), [=, &pattern](size_t begin, size_t end)
+                {
+                    stream_fill(d + begin * sizeof(T), pattern, (end - begin) * sizeof(T));
+                });
+                return;
+            }
+        }
+#endif
+        if (_is_byte_pattern(value))
+        {
+            unsigned char byte;
+            std::memcpy(&byte, &value, 1);
+
+            parallel_for(0, bytes, copy_grain, [=](size_t begin, size_t end)
+            {
+                std::memset(d + begin, byte, end - begin);
+            });
+            return;
+        }
+    }
+
+    parallel_for(0, n, grain::elementwise, [=, &value](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            dst[i] = value;
+    });
+}
+
+} // namespace kernel
+} // namespace blas
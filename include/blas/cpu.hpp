@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define BLAS_X86 1
+#endif
+
+namespace blas {
+namespace cpu {
+
+//
+//  Instruction set levels the dispatching kernels are built for,
+//  ordered so that a higher level implies all the lower ones
+//
+enum class isa
+{
+    generic,
+    sse4,
+    avx2,
+    avx512
+};
+
+struct features
+{
+    bool sse2     = false;
+    bool sse4_1   = false;
+    bool avx      = false;
+    bool avx2     = false;
+    bool fma      = false;
+    bool avx512f  = false;
+
+    // extensions used by the int8 and half kernels, not part of the isa levels
+    bool f16c       = false;
+    bool avx512bw   = false;
+    bool avx512vnni = false;
+};
+
+#ifdef BLAS_X86
+
+inline
+unsigned long long
+xgetbv(unsigned index)
+{
+    unsigned eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+}
+
+#endif
+
+//
+//  Queries CPUID once; AVX and AVX-512 are only reported when
+//  the OS saves the corresponding register state (XCR0)
+//
+inline
+const features&
+detect()
+{
+    static const features f = []
+    {
+        features f;
+
+#ifdef BLAS_X86
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return f;
+
+        f.sse2   = edx & bit_SSE2;
+        f.sse4_1 = ecx & bit_SSE4_1;
+
+        const bool osxsave = ecx & bit_OSXSAVE;
+        const unsigned long long xcr0 = osxsave ? xgetbv(0) : 0;
+        const bool ymm_state = (xcr0 & 0x06) == 0x06;
+        const bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+
+        f.avx = ymm_state and (ecx & bit_AVX);
+        f.fma = ymm_state and (ecx & bit_FMA);
+
+        f.f16c = ymm_state and (ecx & bit_F16C);
+
+        if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        {
+            f.avx2    = ymm_state and (ebx & bit_AVX2);
+            f.avx512f = zmm_state and (ebx & bit_AVX512F);
+
+            f.avx512bw   = zmm_state and (ebx & bit_AVX512BW);
+            f.avx512vnni = zmm_state and (ecx & bit_AVX512VNNI);
+        }
+#endif
+
+        return f;
+    }();
+
+    return f;
+}
+
+inline
+isa
+best_isa()
+{
+    const features& f = detect();
+
+    if (f.avx512f and f.avx2 and f.fma) return isa::avx512;
+    if (f.avx2 and f.fma)               return isa::avx2;
+    if (f.sse2 and f.sse4_1)            return isa::sse4;
+    return isa::generic;
+}
+
+inline
+isa&
+_active_isa()
+{
+    static isa level = []
+    {
+        isa level = best_isa();
+
+        // BLAS_ISA=generic|sse4|avx2|avx512 lowers the dispatch level
+        if (const char* env = std::getenv("BLAS_ISA"))
+        {
+            isa requested = level;
+            if      (!std::strcmp(env, "generic")) requested = isa::generic;
+            else if (!std::strcmp(env, "sse4"))    requested = isa::sse4;
+            else if (!std::strcmp(env, "avx2"))    requested = isa::avx2;
+            else if (!std::strcmp(env, "avx512"))  requested = isa::avx512;
+
+            if (requested < level) level = requested;
+        }
+
+        return level;
+    }();
+
+    return level;
+}
+
+//
+//  Level used by the dispatching kernels
+//
+inline
+isa
+active_isa()
+{
+    return _active_isa();
+}
+
+//
+//  Forces the dispatch level, clamped to what the host supports
+//
+inline
+void
+set_isa(isa level)
+{
+    const isa best = best_isa();
+    _active_isa() = level < best ? level : best;
+}
+
+inline
+const char*
+isa_name(isa level)
+{
+    switch (level)
+    {
+    case isa::sse4:    return "sse4";
+    case isa::avx2:    return "avx2";
+    case isa::avx512:  return "avx512";
+    default:           return "generic";
+    }
+}
+
+} // namespace cpu
+} // namespace blas
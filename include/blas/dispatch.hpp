@@ -0,0 +1,87 @@
+#pragma once
+
+#include "blas/cpu.hpp"
+
+namespace blas {
+namespace kernel {
+
+//
+//  Runs Kernel::run compiled for the active instruction set level
+//  Kernel::run is plain C++ marked always_inline; every wrapper below inlines
+//  it under a different target, so the compiler vectorizes one body per level
+//  Hand-written intrinsics kernels (see gemv.hpp) dispatch on their own
+//
+
+template <typename Kernel, typename... Args>
+void
+_run_generic(Args... args)
+{
+    Kernel::run(args...);
+}
+
+#ifdef BLAS_X86
+
+template <typename Kernel, typename... Args>
+__attribute__((target("sse4.1")))
+void
+_run_sse4(Args... args)
+{
+    Kernel::run(args...);
+}
+
+template <typename Kernel, typename... Args>
+__attribute__((target("avx2,fma")))
+void
+_run_avx2(Args... args)
+{
+    Kernel::run(args...);
+}
+
+template <typename Kernel, typename... Args>
+__attribute__((target("avx512f")))
+void
+_run_avx512(Args... args)
+{
+    Kernel::run(args...);
+}
+
+#endif // BLAS_X86
+
+template <typename Kernel, typename... Args>
+void
+dispatch(Args... args)
+{
+#ifdef BLAS_X86
+    switch (cpu::active_isa())
+    {
+    case cpu::isa::avx512:  return _run_avx512<Kernel>(args...);
+    case cpu::isa::avx2:    return _run_avx2<Kernel>(args...);
+    case cpu::isa::sse4:    return _run_sse4<Kernel>(args...);
+    default:                break;
+    }
+#endif
+    _run_generic<Kernel>(args...);
+}
+
+//
+//  Same for kernels whose code depends on the level beyond its target,
+//  e.g. the size of a register tile: runs Kernel<level>::run
+//
+template <template <cpu::isa> class Kernel, typename... Args>
+void
+dispatch(Args... args)
+{
+#ifdef BLAS_X86
+    switch (cpu::active_isa())
+    {
+    case cpu::isa::avx512:  return _run_avx512<Kernel<cpu::isa::avx512>>(args...);
+    case cpu::isa::avx2:    return _run_avx2<Kernel<cpu::isa::avx2>>(args...);
+    case cpu::isa::sse4:    return _run_sse4<Kernel<cpu::isa::sse4>>(args...);
+    default:                break;
+    }
+#endif
+    _run_generic<Kernel<cpu::isa::generic>>(args...);
+}
+
+} // namespace kernel
+} // namespace blas
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <cassert>
+#include <stdexcept>
+
+namespace blas {
+
+//
+//  Lazy element-wise expressions over vectors and matrices
+//  Operators build a tree of lightweight nodes; nothing is computed until the
+//  tree is assigned to a container, which then evaluates it in a single loop
+//  Containers are captured by reference and nodes by value, so an expression
+//  must not outlive the temporaries it refers to
+//
+
+template <typename E>
+struct vector_expression
+{
+    const E&
+    self() const
+    {
+        return static_cast<const E&>(*this);
+    }
+};
+
+template <typename E>
+struct matrix_expression
+{
+    const E&
+    self() const
+    {
+        return static_cast<const E&>(*this);
+    }
+};
+
+// Operations /////////////////////////////////////////////////////////////
+
+namespace op {
+
+struct add
+{
+    template <typename A, typename B>
+    auto operator () (const A& a, const B& b) const { return a + b; }
+};
+
+struct sub
+{
+    template <typename A, typename B>
+    auto operator () (const A& a, const B& b) const { return a - b; }
+};
+
+struct mul
+{
+    template <typename A, typename B>
+    auto operator () (const A& a, const B& b) const { return a * b; }
+};
+
+struct div
+{
+    template <typename A, typename B>
+    auto operator () (const A& a, const B& b) const { return a / b; }
+};
+
+struct neg
+{
+    template <typename A>
+    auto operator () (const A& a) const { return -a; }
+};
+
+} // namespace op
+
+// Element access /////////////////////////////////////////////////////////
+
+//
+//  Flat element of an operand; overloaded for containers whose
+//  operator [] does something else (matrix returns a row)
+//
+template <typename E>
+auto
+element(const E& e, unsigned index)
+{
+    return e[index];
+}
+
+// Nodes //////////////////////////////////////////////////////////////////
+
+template <template <typename> class Kind, typename L, typename R, typename Op>
+struct binary_expression;
+
+template <template <typename> class Kind, typename E, typename Op>
+struct scalar_right_expression;
+
+template <template <typename> class Kind, typename E, typename Op>
+struct scalar_left_expression;
+
+template <template <typename> class Kind, typename E, typename Op>
+struct unary_expression;
+
+//
+//  How an operand is held inside a node: containers by reference, nodes by value
+//
+template <typename E>
+struct operand
+{
+    typedef const E& type;
+};
+
+template <template <typename> class Kind, typename L, typename R, typename Op>
+struct operand<binary_expression<Kind, L, R, Op>>
+{
+    typedef binary_expression<Kind, L, R, Op> type;
+};
+
+template <template <typename> class Kind, typename E, typename Op>
+struct operand<scalar_right_expression<Kind, E, Op>>
+{
+    typedef scalar_right_expression<Kind, E, Op> type;
+};
+
+template <template <typename> class Kind, typename E, typename Op>
+struct operand<scalar_left_expression<Kind, E, Op>>
+{
+    typedef scalar_left_expression<Kind, E, Op> type;
+};
+
+template <template <typename> class Kind, typename E, typename Op>
+struct operand<unary_expression<Kind, E, Op>>
+{
+    typedef unary_expression<Kind, E, Op> type;
+};
+
+template <template <typename> class Kind, typename L, typename R, typename Op>
+struct binary_expression : Kind<binary_expression<Kind, L, R, Op>>
+{
+    typedef typename L::value_type  value_type;
+    typedef unsigned                size_type;
+
+    typename operand<L>::type _lhs;
+    typename operand<R>::type _rhs;
+
+    binary_expression(const L& lhs, const R& rhs)
+    :   _lhs(lhs),
+        _rhs(rhs)
+    {}
+
+    value_type
+    operator [] (size_type index) const
+    {
+        return Op()(element(_lhs, index), element(_rhs, index));
+    }
+
+    size_type size()   const { return _lhs.size(); }
+    size_type height() const { return _lhs.height(); }
+    size_type width()  const { return _lhs.width(); }
+};
+
+template <template <typename> class Kind, typename E, typename Op>
+struct scalar_right_expression : Kind<scalar_right_expression<Kind, E, Op>>
+{
+    typedef typename E::value_type  value_type;
+    typedef unsigned                size_type;
+
+    typename operand<E>::type _expr;
+    value_type _scalar;
+
+    scalar_right_expression(const E& expr, const value_type& scalar)
+    :   _expr(expr),
+        _scalar(scalar)
+    {}
+
+    value_type
+    operator [] (size_type index) const
+    {
+        return Op()(element(_expr, index), _scalar);
+    }
+
+    size_type size()   const { return _expr.size(); }
+    size_type height() const { return _expr.height(); }
+    size_type width()  const { return _expr.width(); }
+};
+
+template <template <typename> class Kind, typename E, typename Op>
+struct scalar_left_expression : Kind<scalar_left_expression<Kind, E, Op>>
+{
+    typedef typename E::value_type  value_type;
+    typedef unsigned                size_type;
+
+    value_type _scalar;
+    typename operand<E>::type _expr;
+
+    scalar_left_expression(const value_type& scalar, const E& expr)
+    :   _scalar(scalar),
+        _expr(expr)
+    {}
+
+    value_type
+    operator [] (size_type index) const
+    {
+        return Op()(_scalar, element(_expr, index));
+    }
+
+    size_type size()   const { return _expr.size(); }
+    size_type height() const { return _expr.height(); }
+    size_type width()  const { return _expr.width(); }
+};
+
+template <template <typename> class Kind, typename E, typename Op>
+struct unary_expression : Kind<unary_expression<Kind, E, Op>>
+{
+    typedef typename E::value_type  value_type;
+    typedef unsigned                size_type;
+
+    typename operand<E>::type _expr;
+
+    unary_expression(const E& expr)
+    :   _expr(expr)
+    {}
+
+    value_type
+    operator [] (size_type index) const
+    {
+        return Op()(element(_expr, index));
+    }
+
+    size_type size()   const { return _expr.size(); }
+    size_type height() const { return _expr.height(); }
+    size_type width()  const { return _expr.width(); }
+};
+
+// Vector operators ///////////////////////////////////////////////////////
+
+template <typename Op, typename L, typename R>
+binary_expression<vector_expression, L, R, Op>
+make_vector_expression(const vector_expression<L>& lhs, const vector_expression<R>& rhs)
+{
+    if (lhs.self().size() != rhs.self().size())
+        throw std::invalid_argument("vector expression: size mismatch");
+
+    return binary_expression<vector_expression, L, R, Op>(lhs.self(), rhs.self());
+}
+
+template <typename L, typename R>
+auto
+operator + (const vector_expression<L>& lhs, const vector_expression<R>& rhs)
+{
+    return make_vector_expression<op::add>(lhs, rhs);
+}
+
+template <typename L, typename R>
+auto
+operator - (const vector_expression<L>& lhs, const vector_expression<R>& rhs)
+{
+    return make_vector_expression<op::sub>(lhs, rhs);
+}
+
+template <typename L, typename R>
+auto
+operator * (const vector_expression<L>& lhs, const vector_expression<R>& rhs)
+{
+    return make_vector_expression<op::mul>(lhs, rhs);
+}
+
+template <typename L, typename R>
+auto
+operator / (const vector_expression<L>& lhs, const vector_expression<R>& rhs)
+{
+    return make_vector_expression<op::div>(lhs, rhs);
+}
+
+template <typename E>
+scalar_right_expression<vector_expression, E, op::add>
+operator + (const vector_expression<E>& v, const typename E::value_type& value)
+{
+    return { v.self(), value };
+}
+
+template <typename E>
+scalar_right_expression<vector_expression, E, op::sub>
+operator - (const vector_expression<E>& v, const typename E::value_type& value)
+{
+    return { v.self(), value };
+}
+
+template <typename E>
+scalar_right_expression<vector_expression, E, op::mul>
+operator * (const vector_expression<E>& v, const typename E::value_type& value)
+{
+    return { v.self(), value };
+}
+
+template <typename E>
+scalar_right_expression<vector_expression, E, op::div>
+operator / (const vector_expression<E>& v, const typename E::value_type& value)
+{
+    return { v.self(), value };
+}
+
+template <typename E>
+scalar_left_expression<vector_expression, E, op::add>
+operator + (const typename E::value_type& value, const vector_expression<E>& v)
+{
+    return { value, v.self() };
+}
+
+template <typename E>
+scalar_left_expression<vector_expression, E, op::sub>
+operator - (const typename E::value_type& value, const vector_expression<E>& v)
+{
+    return { value, v.self() };
+}
+
+template <typename E>
+scalar_left_expression<vector_expression, E, op::mul>
+operator * (const typename E::value_type& value, const vector_expression<E>& v)
+{
+    return { value, v.self() };
+}
+
+template <typename E>
+unary_expression<vector_expression, E, op::neg>
+operator - (const vector_expression<E>& v)
+{
+    return { v.self() };
+}
+
+template <typename E>
+const E&
+operator + (const vector_expression<E>& v)
+{
+    return v.self();
+}
+
+// Matrix operators ///////////////////////////////////////////////////////
+
+template <typename Op, typename L, typename R>
+binary_expression<matrix_expression, L, R, Op>
+make_matrix_expression(const matrix_expression<L>& lhs, const matrix_expression<R>& rhs)
+{
+    assert(lhs.self().height() == rhs.self().height() and lhs.self().width() == rhs.self().width());
+
+    return binary_expression<matrix_expression, L, R, Op>(lhs.self(), rhs.self());
+}
+
+template <typename L, typename R>
+auto
+operator + (const matrix_expression<L>& lhs, const matrix_expression<R>& rhs)
+{
+    return make_matrix_expression<op::add>(lhs, rhs);
+}
+
+template <typename L, typename R>
+auto
+operator - (const matrix_expression<L>& lhs, const matrix_expression<R>& rhs)
+{
+    return make_matrix_expression<op::sub>(lhs, rhs);
+}
+
+template <typename E>
+scalar_right_expression<matrix_expression, E, op::mul>
+operator * (const matrix_expression<E>& m, const typename E::value_type& scalar)
+{
+    return { m.self(), scalar };
+}
+
+template <typename E>
+scalar_right_expression<matrix_expression, E, op::div>
+operator / (const matrix_expression<E>& m, const typename E::value_type& scalar)
+{
+    return { m.self(), scalar };
+}
+
+template <typename E>
+scalar_left_expression<matrix_expression, E, op::mul>
+operator * (const typename E::value_type& scalar, const matrix_expression<E>& m)
+{
+    return { scalar, m.self() };
+}
+
+} // namespace blas
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <cstddef>
+
+#include "blas/allocator.hpp"
+#include "blas/cblas.hpp"
+#include "blas/dispatch.hpp"
+#include "blas/thread_pool.hpp"
+
+namespace blas {
+namespace kernel {
+
+//
+//  Blocking parameters of the GEMM engine
+//  kc x nr panel of B is meant to stay in L1, mc x kc block of A in L2 and
+//  kc x nc panel of B in L3; mc is a multiple of every level's mr
+//
+template <typename T>
+struct gemm_blocking
+{
+    static constexpr size_t mc = 168;
+    static constexpr size_t kc = 256;
+    static constexpr size_t nc = 2048;
+};
+
+template <>
+struct gemm_blocking<double>
+{
+    static constexpr size_t mc = 84;
+    static constexpr size_t kc = 256;
+    static constexpr size_t nc = 2048;
+};
+
+//
+//  Register tile of the micro-kernel at each dispatch level: mr rows of two
+//  vectors of width bytes; the 2 * mr accumulators, the row of B and the
+//  broadcast of A fit in the 16 vector registers up to AVX2, 32 with AVX-512
+//
+template <typename T, cpu::isa level>
+struct gemm_tile
+{
+    static constexpr size_t width = level == cpu::isa::avx512 ? 64 : level == cpu::isa::avx2 ? 32 : 16;
+    static constexpr size_t mr = level == cpu::isa::avx512 ? 14 : level == cpu::isa::generic ? 4 : 6;
+    static constexpr size_t nr = 2 * width / sizeof(T);
+};
+
+//
+//  Products below this amount of multiply-adds skip packing
+//  and go through a plain i-k-j loop
+//
+constexpr size_t gemm_small_threshold = 32 * 32 * 32;
+
+//
+//  Thread local packing buffer, grows on demand and is never shrunk
+//
+template <typename T>
+class gemm_buffer
+{
+    T* _data = nullptr;
+    size_t _capacity = 0;
+
+public:
+
+    ~gemm_buffer()
+    {
+        allocator<T>::deallocate(_data);
+    }
+
+    T*
+    get(size_t size)
+    {
+        if (size > _capacity)
+        {
+            allocator<T>::deallocate(_data);
+            _data = allocator<T>::allocate(size);
+            _capacity = size;
+        }
+        return _data;
+    }
+};
+
+// Packing ////////////////////////////////////////////////////////////////
+
+//
+//  Packs mc x kc block of A into mr-row panels, each panel stored
+//  column after column and zero padded to mr rows
+//  A(i, p) is a[i * rsa + p * csa], so a transposed operand only swaps strides
+//
+template <size_t mr, typename T>
+inline __attribute__((always_inline))
+void
+pack_a(size_t mc, size_t kc, const T* a, size_t rsa, size_t csa, T* packed)
+{
+    for (size_t ir = 0; ir < mc; ir += mr)
+    {
+        const size_t m = mc - ir < mr ? mc - ir : mr;
+        const T* panel = a + ir * rsa;
+
+        for (size_t p = 0; p < kc; ++p)
+        {
+            size_t i = 0;
+            for (; i < m; ++i)
+                *packed++ = panel[i * rsa + p * csa];
+            for (; i < mr; ++i)
+                *packed++ = T(0);
+        }
+    }
+}
+
+//
+//  Packs kc x nc block of B into nr-column panels, each panel stored
+//  row after row and zero padded to nr columns
+//  B(p, j) is b[p * rsb + j * csb]
+//
+template <size_t nr, typename T>
+inline __attribute__((always_inline))
+void
+pack_b(size_t kc, size_t nc, const T* b, size_t rsb, size_t csb, T* packed)
+{
+    for (size_t jr = 0; jr < nc; jr += nr)
+    {
+        const size_t n = nc - jr < nr ? nc - jr : nr;
+        const T* panel = b + jr * csb;
+
+        for (size_t p = 0; p < kc; ++p)
+        {
+            const T* b_row = panel + p * rsb;
+
+            size_t j = 0;
+            for (; j < n; ++j)
+                *packed++ = b_row[j * csb];
+            for (; j < nr; ++j)
+                *packed++ = T(0);
+        }
+    }
+}
+
+// Micro-kernel ///////////////////////////////////////////////////////////
+
+//
+//  C[m x n] += A_panel * B_panel over kc, accumulating in the register tile
+//  of the level; m and n are smaller than mr and nr only on the edges
+//  The tile is held in GCC vector types and every loop over it is unrolled,
+//  so the accumulators stay in registers
+//
+template <typename Tile, typename T>
+inline __attribute__((always_inline))
+void
+micro_kernel(size_t kc, const T* a, const T* b, T* c, size_t ldc, size_t m, size_t n)
+{
+    constexpr size_t mr = Tile::mr;
+    constexpr size_t nr = Tile::nr;
+    constexpr size_t lanes = Tile::width / sizeof(T);
+    constexpr size_t vectors = nr / lanes;
+
+    typedef T vector_type __attribute__((vector_size(Tile::width)));
+
+    vector_type ab[mr][vectors] = {};
+
+    for (size_t p = 0; p < kc; ++p)
+    {
+        vector_type b_row[vectors];
+#pragma GCC unroll 16
+        for (size_t j = 0; j < vectors; ++j)
+            __builtin_memcpy(&b_row[j], b + j * lanes, sizeof(vector_type));
+
+#pragma GCC unroll 16
+        for (size_t i = 0; i < mr; ++i)
+        {
+            const T a_i = a[i];
+#pragma GCC unroll 16
+            for (size_t j = 0; j < vectors; ++j)
+                ab[i][j] += a_i * b_row[j];
+        }
+
+        a += mr;
+        b += nr;
+    }
+
+    if (m == mr and n == nr)
+    {
+#pragma GCC unroll 16
+        for (size_t i = 0; i < mr; ++i)
+        {
+#pragma GCC unroll 16
+            for (size_t j = 0; j < vectors; ++j)
+            {
+                vector_type c_ij;
+                __builtin_memcpy(&c_ij, c + i * ldc + j * lanes, sizeof(vector_type));
+                c_ij += ab[i][j];
+                __builtin_memcpy(c + i * ldc + j * lanes, &c_ij, sizeof(vector_type));
+            }
+        }
+    } else {
+        T tile[mr][nr];
+        __builtin_memcpy(tile, ab, sizeof(tile));
+
+        for (size_t i = 0; i < m; ++i)
+            for (size_t j = 0; j < n; ++j)
+                c[i * ldc + j] += tile[i][j];
+    }
+}
+
+// GEMM ///////////////////////////////////////////////////////////////////
+
+//
+//  C += A * B through the packed engine, single threaded
+//  Packing and the micro-kernel inline into run, which dispatch compiles
+//  for every instruction set level with that level's register tile
+//
+template <cpu::isa level>
+struct gemm_blocked_kernel
+{
+    template <typename T>
+    static inline __attribute__((always_inline))
+    void
+    run(
+        size_t m, size_t n, size_t k,
+        const T* a, size_t rsa, size_t csa,
+        const T* b, size_t rsb, size_t csb,
+        T* c, size_t ldc,
+        gemm_buffer<T>* a_buffer, gemm_buffer<T>* b_buffer
+    )
+    {
+        typedef gemm_blocking<T> blocking;
+        typedef gemm_tile<T, level> tile;
+
+        // panels are zero padded to whole mr x kc and kc x nr tiles
+        T* packed_a = a_buffer->get((blocking::mc + tile::mr - 1) / tile::mr * tile::mr * blocking::kc);
+        T* packed_b = b_buffer->get(blocking::kc * ((blocking::nc + tile::nr - 1) / tile::nr * tile::nr));
+
+        for (size_t jc = 0; jc < n; jc += blocking::nc)
+        {
+            const size_t nc = n - jc < blocking::nc ? n - jc : blocking::nc;
+
+            for (size_t pc = 0; pc < k; pc += blocking::kc)
+            {
+                const size_t kc = k - pc < blocking::kc ? k - pc : blocking::kc;
+
+                pack_b<tile::nr>(kc, nc, b + pc * rsb + jc * csb, rsb, csb, packed_b);
+
+                for (size_t ic = 0; ic < m; ic += blocking::mc)
+                {
+                    const size_t mc = m - ic < blocking::mc ? m - ic : blocking::mc;
+
+                    pack_a<tile::mr>(mc, kc, a + ic * rsa + pc * csa, rsa, csa, packed_a);
+
+                    for (size_t jr = 0; jr < nc; jr += tile::nr)
+                    {
+                        const size_t nr = nc - jr < tile::nr ? nc - jr : tile::nr;
+                        const T* b_panel = packed_b + jr * kc;
+
+                        for (size_t ir = 0; ir < mc; ir += tile::mr)
+                        {
+                            const size_t mr = mc - ir < tile::mr ? mc - ir : tile::mr;
+                            const T* a_panel = packed_a + ir * kc;
+
+                            micro_kernel<tile>(kc, a_panel, b_panel, c + (ic + ir) * ldc + jc + jr, ldc, mr, nr);
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+template <typename T>
+void
+gemm_blocked(
+    size_t m, size_t n, size_t k,
+    const T* a, size_t rsa, size_t csa,
+    const T* b, size_t rsb, size_t csb,
+    T* c, size_t ldc
+)
+{
+    static thread_local gemm_buffer<T> a_buffer, b_buffer;
+
+    dispatch<gemm_blocked_kernel>(m, n, k, a, rsa, csa, b, rsb, csb, c, ldc, &a_buffer, &b_buffer);
+}
+
+//
+//  C = A * B + beta * C for A[m x k], B[k x n] given by row and column
+//  strides, and row-major C[m x n]
+//
+template <typename T>
+void
+gemm(
+    size_t m, size_t n, size_t k,
+    const T* a, size_t rsa, size_t csa,
+    const T* b, size_t rsb, size_t csb,
+    T beta, T* c, size_t ldc
+)
+{
+    typedef gemm_blocking<T> blocking;
+
+    if (external::gemm(m, n, k, a, rsa, csa, b, rsb, csb, beta, c, ldc)) return;
+
+    for (size_t i = 0; i < m; ++i)
+    {
+        T* c_row = c + i * ldc;
+        if (beta == T(0))
+            for (size_t j = 0; j < n; ++j)
+                c_row[j] = T(0);
+        else if (beta != T(1))
+            for (size_t j = 0; j < n; ++j)
+                c_row[j] *= beta;
+    }
+
+    if (m == 0 or n == 0 or k == 0) return;
+
+    if (m * n * k <= gemm_small_threshold)
+    {
+        for (size_t i = 0; i < m; ++i)
+        {
+            T* c_row = c + i * ldc;
+            const T* a_row = a + i * rsa;
+
+            for (size_t p = 0; p < k; ++p)
+            {
+                const T a_ip = a_row[p * csa];
+                const T* b_row = b + p * rsb;
+
+                for (size_t j = 0; j < n; ++j)
+                    c_row[j] += a_ip * b_row[j * csb];
+            }
+        }
+        return;
+    }
+
+    // bands of mc rows of C are independent; each thread packs its own B panels
+    const size_t bands = (m + blocking::mc - 1) / blocking::mc;
+
+    if (bands > 1)
+    {
+        parallel_for(0, bands, 1, [=](size_t begin, size_t end)
+        {
+            const size_t first = begin * blocking::mc;
+            const size_t last = end * blocking::mc < m ? end * blocking::mc : m;
+
+            gemm_blocked(last - first, n, k, a + first * rsa, rsa, csa, b, rsb, csb, c + first * ldc, ldc);
+        });
+        return;
+    }
+
+    // a single band, e.g. a mini-batch: split C into blocks of whole tiles
+    // of columns instead, one per thread, at most nc wide; each packs all of A
+    // (the widest tile, AVX-512's, is a multiple of the others)
+    constexpr size_t nr = gemm_tile<T, cpu::isa::avx512>::nr;
+
+    const size_t threads = num_threads();
+    size_t width = (n + threads - 1) / threads;
+    width = (width + nr - 1) / nr * nr;
+    width = width < blocking::nc ? width : blocking::nc;
+
+    const size_t blocks = (n + width - 1) / width;
+
+    parallel_for(0, blocks, 1, [=](size_t begin, size_t end)
+    {
+        const size_t first = begin * width;
+        const size_t last = end * width < n ? end * width : n;
+
+        gemm_blocked(m, last - first, k, a, rsa, csa, b + first * csb, rsb, csb, c + first, ldc);
+    });
+}
+
+//
+//  C = A * B + beta * C for row-major A[m x k], B[k x n], C[m x n]
+//
+template <typename T>
+void
+gemm(size_t m, size_t n, size_t k, const T* a, size_t lda, const T* b, size_t ldb, T beta, T* c, size_t ldc)
+{
+    gemm(m, n, k, a, lda, size_t(1), b, ldb, size_t(1), beta, c, ldc);
+}
+
+} // namespace kernel
+} // namespace blas
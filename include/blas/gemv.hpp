@@ -0,0 +1,442 @@
+#pragma once
+
+#include <cstddef>
+
+#include "blas/cpu.hpp"
+#include "blas/cblas.hpp"
+#include "blas/dispatch.hpp"
+#include "blas/thread_pool.hpp"
+
+#ifdef BLAS_X86
+#include <immintrin.h>
+#endif
+
+namespace blas {
+namespace kernel {
+
+//
+//  GEMV kernels: y = A * x for row-major A[m x n]
+//  Every kernel walks R rows per pass, sharing each load of x between them,
+//  and keeps two vector accumulators per row to hide the add latency
+//
+
+// Generic ////////////////////////////////////////////////////////////////
+
+template <size_t R, typename T>
+void
+gemv_rows_generic(size_t n, const T* a, size_t lda, const T* x, T* y)
+{
+    T acc[R][2] = {};
+
+    size_t j = 0;
+    for (; j < n / 2 * 2; j += 2)
+    {
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] += a[r * lda + j] * x[j];
+            acc[r][1] += a[r * lda + j + 1] * x[j + 1];
+        }
+    }
+    for (; j < n; ++j)
+        for (size_t r = 0; r < R; ++r)
+            acc[r][0] += a[r * lda + j] * x[j];
+
+    for (size_t r = 0; r < R; ++r)
+        y[r] = acc[r][0] + acc[r][1];
+}
+
+template <typename T>
+void
+gemv_generic(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y)
+{
+    size_t i = 0;
+    for (; i < m / 4 * 4; i += 4)
+        gemv_rows_generic<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        gemv_rows_generic<1>(n, a + i * lda, lda, x, y + i);
+}
+
+#ifdef BLAS_X86
+
+// SSE2 ///////////////////////////////////////////////////////////////////
+
+template <size_t R>
+__attribute__((target("sse2")))
+void
+gemv_rows_sse2(size_t n, const double* a, size_t lda, const double* x, double* y)
+{
+    __m128d acc[R][2];
+    for (size_t r = 0; r < R; ++r)
+        acc[r][0] = acc[r][1] = _mm_setzero_pd();
+
+    size_t j = 0;
+    for (; j < n / 4 * 4; j += 4)
+    {
+        const __m128d x0 = _mm_loadu_pd(x + j);
+        const __m128d x1 = _mm_loadu_pd(x + j + 2);
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] = _mm_add_pd(acc[r][0], _mm_mul_pd(_mm_loadu_pd(a + r * lda + j), x0));
+            acc[r][1] = _mm_add_pd(acc[r][1], _mm_mul_pd(_mm_loadu_pd(a + r * lda + j + 2), x1));
+        }
+    }
+
+    for (size_t r = 0; r < R; ++r)
+    {
+        const __m128d s = _mm_add_pd(acc[r][0], acc[r][1]);
+        double sum = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+        for (size_t k = j; k < n; ++k)
+            sum += a[r * lda + k] * x[k];
+        y[r] = sum;
+    }
+}
+
+template <size_t R>
+__attribute__((target("sse2")))
+void
+gemv_rows_sse2(size_t n, const float* a, size_t lda, const float* x, float* y)
+{
+    __m128 acc[R][2];
+    for (size_t r = 0; r < R; ++r)
+        acc[r][0] = acc[r][1] = _mm_setzero_ps();
+
+    size_t j = 0;
+    for (; j < n / 8 * 8; j += 8)
+    {
+        const __m128 x0 = _mm_loadu_ps(x + j);
+        const __m128 x1 = _mm_loadu_ps(x + j + 4);
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] = _mm_add_ps(acc[r][0], _mm_mul_ps(_mm_loadu_ps(a + r * lda + j), x0));
+            acc[r][1] = _mm_add_ps(acc[r][1], _mm_mul_ps(_mm_loadu_ps(a + r * lda + j + 4), x1));
+        }
+    }
+
+    for (size_t r = 0; r < R; ++r)
+    {
+        __m128 s = _mm_add_ps(acc[r][0], acc[r][1]);
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        float sum = _mm_cvtss_f32(s);
+        for (size_t k = j; k < n; ++k)
+            sum += a[r * lda + k] * x[k];
+        y[r] = sum;
+    }
+}
+
+// AVX2 ///////////////////////////////////////////////////////////////////
+
+template <size_t R>
+__attribute__((target("avx2,fma")))
+void
+gemv_rows_avx2(size_t n, const double* a, size_t lda, const double* x, double* y)
+{
+    __m256d acc[R][2];
+    for (size_t r = 0; r < R; ++r)
+        acc[r][0] = acc[r][1] = _mm256_setzero_pd();
+
+    size_t j = 0;
+    for (; j < n / 8 * 8; j += 8)
+    {
+        const __m256d x0 = _mm256_loadu_pd(x + j);
+        const __m256d x1 = _mm256_loadu_pd(x + j + 4);
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] = _mm256_fmadd_pd(_mm256_loadu_pd(a + r * lda + j), x0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_pd(_mm256_loadu_pd(a + r * lda + j + 4), x1, acc[r][1]);
+        }
+    }
+
+    for (size_t r = 0; r < R; ++r)
+    {
+        const __m256d s4 = _mm256_add_pd(acc[r][0], acc[r][1]);
+        const __m128d s2 = _mm_add_pd(_mm256_castpd256_pd128(s4), _mm256_extractf128_pd(s4, 1));
+        double sum = _mm_cvtsd_f64(_mm_add_sd(s2, _mm_unpackhi_pd(s2, s2)));
+        for (size_t k = j; k < n; ++k)
+            sum += a[r * lda + k] * x[k];
+        y[r] = sum;
+    }
+}
+
+template <size_t R>
+__attribute__((target("avx2,fma")))
+void
+gemv_rows_avx2(size_t n, const float* a, size_t lda, const float* x, float* y)
+{
+    __m256 acc[R][2];
+    for (size_t r = 0; r < R; ++r)
+        acc[r][0] = acc[r][1] = _mm256_setzero_ps();
+
+    size_t j = 0;
+    for (; j < n / 16 * 16; j += 16)
+    {
+        const __m256 x0 = _mm256_loadu_ps(x + j);
+        const __m256 x1 = _mm256_loadu_ps(x + j + 8);
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] = _mm256_fmadd_ps(_mm256_loadu_ps(a + r * lda + j), x0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_ps(_mm256_loadu_ps(a + r * lda + j + 8), x1, acc[r][1]);
+        }
+    }
+
+    for (size_t r = 0; r < R; ++r)
+    {
+        const __m256 s8 = _mm256_add_ps(acc[r][0], acc[r][1]);
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        float sum = _mm_cvtss_f32(s);
+        for (size_t k = j; k < n; ++k)
+            sum += a[r * lda + k] * x[k];
+        y[r] = sum;
+    }
+}
+
+// AVX-512 ////////////////////////////////////////////////////////////////
+
+//
+//  Horizontal sums; the maskz extracts avoid the uninitialized-register
+//  warning GCC raises inside _mm512_reduce_add_*
+//
+__attribute__((target("avx512f")))
+inline
+double
+hsum_avx512(__m512d v)
+{
+    const __m256d s4 = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xff, v, 0), _mm512_maskz_extractf64x4_pd(0xff, v, 1));
+    const __m128d s2 = _mm_add_pd(_mm256_castpd256_pd128(s4), _mm256_extractf128_pd(s4, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s2, _mm_unpackhi_pd(s2, s2)));
+}
+
+__attribute__((target("avx512f")))
+inline
+float
+hsum_avx512(__m512 v)
+{
+    const __m512d bits = _mm512_castps_pd(v);
+    const __m256 s8 = _mm256_add_ps(
+        _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, bits, 0)),
+        _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, bits, 1))
+    );
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+template <size_t R>
+__attribute__((target("avx512f")))
+void
+gemv_rows_avx512(size_t n, const double* a, size_t lda, const double* x, double* y)
+{
+    __m512d acc[R][2];
+    for (size_t r = 0; r < R; ++r)
+        acc[r][0] = acc[r][1] = _mm512_setzero_pd();
+
+    size_t j = 0;
+    for (; j < n / 16 * 16; j += 16)
+    {
+        const __m512d x0 = _mm512_loadu_pd(x + j);
+        const __m512d x1 = _mm512_loadu_pd(x + j + 8);
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] = _mm512_fmadd_pd(_mm512_loadu_pd(a + r * lda + j), x0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_pd(_mm512_loadu_pd(a + r * lda + j + 8), x1, acc[r][1]);
+        }
+    }
+    for (; j < n; j += 8)
+    {
+        // masked loads zero the lanes past the end of the row
+        const __mmask8 mask = n - j >= 8 ? 0xff : static_cast<__mmask8>((1u << (n - j)) - 1);
+        const __m512d x0 = _mm512_maskz_loadu_pd(mask, x + j);
+        for (size_t r = 0; r < R; ++r)
+            acc[r][0] = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a + r * lda + j), x0, acc[r][0]);
+    }
+
+    for (size_t r = 0; r < R; ++r)
+        y[r] = hsum_avx512(_mm512_add_pd(acc[r][0], acc[r][1]));
+}
+
+template <size_t R>
+__attribute__((target("avx512f")))
+void
+gemv_rows_avx512(size_t n, const float* a, size_t lda, const float* x, float* y)
+{
+    __m512 acc[R][2];
+    for (size_t r = 0; r < R; ++r)
+        acc[r][0] = acc[r][1] = _mm512_setzero_ps();
+
+    size_t j = 0;
+    for (; j < n / 32 * 32; j += 32)
+    {
+        const __m512 x0 = _mm512_loadu_ps(x + j);
+        const __m512 x1 = _mm512_loadu_ps(x + j + 16);
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] = _mm512_fmadd_ps(_mm512_loadu_ps(a + r * lda + j), x0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_ps(_mm512_loadu_ps(a + r * lda + j + 16), x1, acc[r][1]);
+        }
+    }
+    for (; j < n; j += 16)
+    {
+        const __mmask16 mask = n - j >= 16 ? 0xffff : static_cast<__mmask16>((1u << (n - j)) - 1);
+        const __m512 x0 = _mm512_maskz_loadu_ps(mask, x + j);
+        for (size_t r = 0; r < R; ++r)
+            acc[r][0] = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + r * lda + j), x0, acc[r][0]);
+    }
+
+    for (size_t r = 0; r < R; ++r)
+        y[r] = hsum_avx512(_mm512_add_ps(acc[r][0], acc[r][1]));
+}
+
+// Drivers ////////////////////////////////////////////////////////////////
+
+template <typename T>
+void
+gemv_sse2(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y)
+{
+    size_t i = 0;
+    for (; i < m / 4 * 4; i += 4)
+        gemv_rows_sse2<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        gemv_rows_sse2<1>(n, a + i * lda, lda, x, y + i);
+}
+
+template <typename T>
+void
+gemv_avx2(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y)
+{
+    size_t i = 0;
+    for (; i < m / 4 * 4; i += 4)
+        gemv_rows_avx2<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        gemv_rows_avx2<1>(n, a + i * lda, lda, x, y + i);
+}
+
+template <typename T>
+void
+gemv_avx512(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y)
+{
+    size_t i = 0;
+    for (; i < m / 4 * 4; i += 4)
+        gemv_rows_avx512<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        gemv_rows_avx512<1>(n, a + i * lda, lda, x, y + i);
+}
+
+#endif // BLAS_X86
+
+// Dispatch ///////////////////////////////////////////////////////////////
+
+template <typename T>
+void
+_gemv_dispatch(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y)
+{
+#ifdef BLAS_X86
+    switch (cpu::active_isa())
+    {
+    case cpu::isa::avx512:  return gemv_avx512(m, n, a, lda, x, y);
+    case cpu::isa::avx2:    return gemv_avx2(m, n, a, lda, x, y);
+    // the kernel needs nothing past SSE2, which the sse4 level implies
+    case cpu::isa::sse4:    return gemv_sse2(m, n, a, lda, x, y);
+    default:                break;
+    }
+#endif
+    gemv_generic(m, n, a, lda, x, y);
+}
+
+template <typename T>
+void
+_gemv_serial(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y)
+{
+    gemv_generic(m, n, a, lda, x, y);
+}
+
+inline
+void
+_gemv_serial(size_t m, size_t n, const float* a, size_t lda, const float* x, float* y)
+{
+    _gemv_dispatch(m, n, a, lda, x, y);
+}
+
+inline
+void
+_gemv_serial(size_t m, size_t n, const double* a, size_t lda, const double* x, double* y)
+{
+    _gemv_dispatch(m, n, a, lda, x, y);
+}
+
+//
+//  y = A * x, picking the widest kernel the host supports for float and double
+//  and splitting rows across the thread pool for large matrices
+//
+template <typename T>
+void
+gemv(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y)
+{
+    if (external::gemv(m, n, a, lda, x, y)) return;
+
+    parallel_for(0, m, grain::rows(n), [=](size_t begin, size_t end)
+    {
+        _gemv_serial(end - begin, n, a + begin * lda, lda, x, y + begin);
+    });
+}
+
+// Transposed GEMV ////////////////////////////////////////////////////////
+
+//
+//  y = A^T * x for row-major A[m x n], without forming A^T
+//  A is streamed row by row and four rows are folded into y per pass,
+//  so y (n elements) stays in L1 and A is read exactly once
+//
+struct gemv_t_kernel
+{
+    template <typename T>
+    static inline __attribute__((always_inline))
+    void
+    run(size_t m, size_t n, const T* a, size_t lda, const T* x, T* __restrict y)
+    {
+        for (size_t j = 0; j < n; ++j)
+            y[j] = T(0);
+
+        size_t i = 0;
+        for (; i < m / 4 * 4; i += 4)
+        {
+            const T x0 = x[i], x1 = x[i + 1], x2 = x[i + 2], x3 = x[i + 3];
+            const T* __restrict a0 = a + i * lda;
+            const T* __restrict a1 = a0 + lda;
+            const T* __restrict a2 = a1 + lda;
+            const T* __restrict a3 = a2 + lda;
+
+            for (size_t j = 0; j < n; ++j)
+                y[j] += x0 * a0[j] + x1 * a1[j] + x2 * a2[j] + x3 * a3[j];
+        }
+        for (; i < m; ++i)
+        {
+            const T xi = x[i];
+            const T* __restrict ai = a + i * lda;
+
+            for (size_t j = 0; j < n; ++j)
+                y[j] += xi * ai[j];
+        }
+    }
+};
+
+template <typename T>
+void
+gemv_t(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y)
+{
+    if (external::gemv_t(m, n, a, lda, x, y)) return;
+
+    // columns of y are independent, so large products split them across
+    // the pool in cache line multiples
+    const size_t columns = (grain::rows(m) + 63) / 64 * 64;
+
+    parallel_for(0, n, columns, [=](size_t begin, size_t end)
+    {
+        dispatch<gemv_t_kernel>(m, end - begin, a + begin, lda, x, y + begin);
+    });
+}
+
+} // namespace kernel
+} // namespace blas
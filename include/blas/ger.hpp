@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+
+#include "blas/cblas.hpp"
+#include "blas/dispatch.hpp"
+#include "blas/thread_pool.hpp"
+
+namespace blas {
+namespace kernel {
+
+//
+//  y += alpha * x
+//
+struct axpy_kernel
+{
+    template <typename T>
+    static inline __attribute__((always_inline))
+    void
+    run(size_t n, T alpha, const T* x, T* __restrict y)
+    {
+        for (size_t j = 0; j < n; ++j)
+            y[j] += alpha * x[j];
+    }
+};
+
+//
+//  A += alpha * x * y^T for row-major A[m x n]
+//  Each row of A is one axpy with alpha * x[i]; rows with a zero
+//  coefficient are skipped as in reference BLAS
+//
+struct ger_kernel
+{
+    template <typename T>
+    static inline __attribute__((always_inline))
+    void
+    run(size_t m, size_t n, T alpha, const T* x, const T* y, T* a, size_t lda)
+    {
+        for (size_t i = 0; i < m; ++i)
+        {
+            const T coefficient = alpha * x[i];
+            if (coefficient == T(0)) continue;
+
+            axpy_kernel::run(n, coefficient, y, a + i * lda);
+        }
+    }
+};
+
+template <typename T>
+void
+axpy(size_t n, T alpha, const T* x, T* y)
+{
+    parallel_for(0, n, grain::elementwise, [=](size_t begin, size_t end)
+    {
+        dispatch<axpy_kernel>(end - begin, alpha, x + begin, y + begin);
+    });
+}
+
+template <typename T>
+void
+ger(size_t m, size_t n, T alpha, const T* x, const T* y, T* a, size_t lda)
+{
+    if (external::ger(m, n, alpha, x, y, a, lda)) return;
+
+    parallel_for(0, m, grain::rows(n), [=](size_t begin, size_t end)
+    {
+        dispatch<ger_kernel>(end - begin, n, alpha, x + begin, y, a + begin * lda, lda);
+    });
+}
+
+} // namespace kernel
+} // namespace blas
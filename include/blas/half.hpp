@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace blas {
+
+//
+//  16-bit floating point storage types
+//  They only convert to and from float; arithmetic widens to float first
+//  Both round to nearest even when narrowing
+//
+
+inline
+uint32_t
+_float_bits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline
+float
+_bits_float(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//
+//  bfloat16: the upper half of a float, 8 exponent and 7 mantissa bits
+//  Same range as float, about 3 significant decimal digits
+//
+struct bfloat16
+{
+    uint16_t bits;
+
+    bfloat16() = default;
+
+    bfloat16(float value)
+    {
+        uint32_t f = _float_bits(value);
+
+        if ((f & 0x7fffffff) > 0x7f800000)
+        {
+            // keep NaN a quiet NaN
+            bits = uint16_t((f >> 16) | 0x40);
+            return;
+        }
+
+        f += 0x7fff + ((f >> 16) & 1);
+        bits = uint16_t(f >> 16);
+    }
+
+    operator float() const
+    {
+        return _bits_float(uint32_t(bits) << 16);
+    }
+};
+
+//
+//  IEEE binary16: 5 exponent and 10 mantissa bits
+//  Largest finite value 65504, about 3.3 significant decimal digits
+//
+struct float16
+{
+    uint16_t bits;
+
+    float16() = default;
+
+    float16(float value)
+    {
+        uint32_t f = _float_bits(value);
+        const uint32_t sign = (f >> 16) & 0x8000;
+        f &= 0x7fffffff;
+
+        if (f >= 0x7f800000)
+        {
+            // infinity stays infinity, NaN becomes a quiet NaN
+            bits = uint16_t(sign | (f > 0x7f800000 ? 0x7e00 : 0x7c00));
+        } else if (f >= 0x477ff000) {
+            // rounds to 65520 or above
+            bits = uint16_t(sign | 0x7c00);
+        } else if (f < 0x38800000) {
+            // subnormal or zero; adding 0.5 makes the float unit in the last
+            // place equal to the half one, so the hardware does the rounding
+            bits = uint16_t(sign | (_float_bits(_bits_float(f) + 0.5f) - 0x3f000000));
+        } else {
+            // rebias the exponent and round the 13 dropped bits to even
+            f += 0xc8000fff + ((f >> 13) & 1);
+            bits = uint16_t(sign | (f >> 13));
+        }
+    }
+
+    operator float() const
+    {
+        const uint32_t sign = uint32_t(bits & 0x8000) << 16;
+        const uint32_t exponent = (bits >> 10) & 0x1f;
+        const uint32_t mantissa = bits & 0x3ff;
+
+        if (exponent == 0)
+        {
+            const float value = float(mantissa) * 5.9604644775390625e-8f;
+            return _bits_float(sign | _float_bits(value));
+        }
+        if (exponent == 0x1f)
+            return _bits_float(sign | 0x7f800000 | (mantissa << 13));
+
+        return _bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+    }
+};
+
+} // namespace blas
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cassert>
+#include <type_traits>
+
+#include "blas/half.hpp"
+#include "blas/hgemv.hpp"
+#include "blas/vector.hpp"
+#include "blas/matrix.hpp"
+
+namespace blas {
+
+//
+//  Read-only copy of a matrix stored as bfloat16 or float16 (H)
+//  Products widen the weights to float and accumulate in float;
+//  x and y are converted when T is not float
+//
+template <typename T, typename H = bfloat16>
+struct half_matrix
+{
+public:
+
+    typedef T           value_type;
+    typedef H           storage_type;
+    typedef unsigned    size_type;
+
+protected:
+
+    vector<H> _data;
+    size_type _height, _width;
+
+public:
+
+// Constructors ///////////////////////////////////////////////////////////
+
+    half_matrix()
+    :   _height(0),
+        _width(0)
+    {}
+
+    template <typename _alloc>
+    explicit
+    half_matrix(const matrix<T, _alloc>& m)
+    :   _data(m.size()),
+        _height(m.height()),
+        _width(m.width())
+    {
+        assign(m);
+    }
+
+// Assignment /////////////////////////////////////////////////////////////
+
+    //
+    //  Rounds a matrix of the same shape into this one
+    //
+    template <typename _alloc>
+    void
+    assign(const matrix<T, _alloc>& m)
+    {
+        assert(_height == m.height() and _width == m.width());
+
+        parallel_for(0, _data.size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] = H(float(m.data()[i]));
+        });
+    }
+
+// Attributes getters /////////////////////////////////////////////////////
+
+    size_type
+    height() const
+    {
+        return _height;
+    }
+
+    size_type
+    width() const
+    {
+        return _width;
+    }
+
+    //
+    //  Bytes of weights a product streams
+    //
+    size_t
+    bytes() const
+    {
+        return size_t(_data.size()) * sizeof(H);
+    }
+
+    const H*
+    data() const
+    {
+        return _data.data();
+    }
+
+// Math ///////////////////////////////////////////////////////////////////
+
+    template <typename _xalloc, typename _yalloc>
+    void
+    multiply(const vector<T, _xalloc>& x, vector<T, _yalloc>& y) const
+    {
+        assert(_width == x.size());
+
+        y.resize(_height);
+
+        if constexpr (std::is_same<T, float>::value)
+        {
+            kernel::hgemv(_height, _width, _data.data(), _width, x.data(), y.data());
+        } else {
+            static thread_local vector<float> xf, yf;
+
+            xf = x;
+            yf.resize(_height);
+
+            kernel::hgemv(_height, _width, _data.data(), _width, xf.data(), yf.data());
+
+            for (size_type i = 0; i < _height; ++i)
+                y[i] = T(yf[i]);
+        }
+    }
+
+    template <typename _valloc>
+    vector<T>
+    operator * (const vector<T, _valloc>& v) const
+    {
+        vector<T> result;
+        multiply(v, result);
+        return result;
+    }
+};
+
+} // namespace blas
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstddef>
+
+#include "blas/cpu.hpp"
+#include "blas/gemv.hpp"
+#include "blas/half.hpp"
+#include "blas/thread_pool.hpp"
+
+#ifdef BLAS_X86
+#include <immintrin.h>
+#endif
+
+namespace blas {
+namespace kernel {
+
+//
+//  Half-width GEMV kernels: y = A * x for row-major A[m x n] stored as
+//  bfloat16 or float16, float x and y
+//  A is widened to float in registers and accumulated with float FMAs,
+//  so only the storage is reduced, not the arithmetic
+//
+
+// Generic ////////////////////////////////////////////////////////////////
+
+template <size_t R, typename H>
+void
+hgemv_rows_generic(size_t n, const H* a, size_t lda, const float* x, float* y)
+{
+    float acc[R][2] = {};
+
+    size_t j = 0;
+    for (; j + 2 <= n; j += 2)
+    {
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] += float(a[r * lda + j]) * x[j];
+            acc[r][1] += float(a[r * lda + j + 1]) * x[j + 1];
+        }
+    }
+    for (; j < n; ++j)
+        for (size_t r = 0; r < R; ++r)
+            acc[r][0] += float(a[r * lda + j]) * x[j];
+
+    for (size_t r = 0; r < R; ++r)
+        y[r] = acc[r][0] + acc[r][1];
+}
+
+template <typename H>
+void
+hgemv_generic(size_t m, size_t n, const H* a, size_t lda, const float* x, float* y)
+{
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4)
+        hgemv_rows_generic<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        hgemv_rows_generic<1>(n, a + i * lda, lda, x, y + i);
+}
+
+#ifdef BLAS_X86
+
+// Widening loads /////////////////////////////////////////////////////////
+
+__attribute__((target("avx2")))
+inline
+__m256
+widen8(const bfloat16* p)
+{
+    const __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(h, 16));
+}
+
+__attribute__((target("avx2,f16c")))
+inline
+__m256
+widen8(const float16* p)
+{
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+//
+//  The all-ones maskz forms avoid the uninitialized-register warning
+//  GCC raises inside the unmasked intrinsics
+//
+__attribute__((target("avx512f")))
+inline
+__m512
+widen16(const bfloat16* p)
+{
+    const __m512i h = _mm512_maskz_cvtepu16_epi32(0xffff, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(0xffff, h, 16));
+}
+
+__attribute__((target("avx512f")))
+inline
+__m512
+widen16(const float16* p)
+{
+    return _mm512_maskz_cvtph_ps(0xffff, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+}
+
+// AVX2 ///////////////////////////////////////////////////////////////////
+
+template <size_t R, typename H>
+__attribute__((target("avx2,fma,f16c")))
+void
+hgemv_rows_avx2(size_t n, const H* a, size_t lda, const float* x, float* y)
+{
+    __m256 acc[R][2];
+    for (size_t r = 0; r < R; ++r)
+        acc[r][0] = acc[r][1] = _mm256_setzero_ps();
+
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        const __m256 x0 = _mm256_loadu_ps(x + j);
+        const __m256 x1 = _mm256_loadu_ps(x + j + 8);
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] = _mm256_fmadd_ps(widen8(a + r * lda + j), x0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_ps(widen8(a + r * lda + j + 8), x1, acc[r][1]);
+        }
+    }
+
+    for (size_t r = 0; r < R; ++r)
+    {
+        const __m256 s8 = _mm256_add_ps(acc[r][0], acc[r][1]);
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        float sum = _mm_cvtss_f32(s);
+        for (size_t k = j; k < n; ++k)
+            sum += float(a[r * lda + k]) * x[k];
+        y[r] = sum;
+    }
+}
+
+// AVX-512 ////////////////////////////////////////////////////////////////
+
+template <size_t R, typename H>
+__attribute__((target("avx512f")))
+void
+hgemv_rows_avx512(size_t n, const H* a, size_t lda, const float* x, float* y)
+{
+    __m512 acc[R][2];
+    for (size_t r = 0; r < R; ++r)
+        acc[r][0] = acc[r][1] = _mm512_setzero_ps();
+
+    size_t j = 0;
+    for (; j + 32 <= n; j += 32)
+    {
+        const __m512 x0 = _mm512_loadu_ps(x + j);
+        const __m512 x1 = _mm512_loadu_ps(x + j + 16);
+        for (size_t r = 0; r < R; ++r)
+        {
+            acc[r][0] = _mm512_fmadd_ps(widen16(a + r * lda + j), x0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_ps(widen16(a + r * lda + j + 16), x1, acc[r][1]);
+        }
+    }
+
+    for (size_t r = 0; r < R; ++r)
+    {
+        float sum = hsum_avx512(_mm512_add_ps(acc[r][0], acc[r][1]));
+        for (size_t k = j; k < n; ++k)
+            sum += float(a[r * lda + k]) * x[k];
+        y[r] = sum;
+    }
+}
+
+// Drivers ////////////////////////////////////////////////////////////////
+
+template <typename H>
+void
+hgemv_avx2(size_t m, size_t n, const H* a, size_t lda, const float* x, float* y)
+{
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4)
+        hgemv_rows_avx2<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        hgemv_rows_avx2<1>(n, a + i * lda, lda, x, y + i);
+}
+
+template <typename H>
+void
+hgemv_avx512(size_t m, size_t n, const H* a, size_t lda, const float* x, float* y)
+{
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4)
+        hgemv_rows_avx512<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        hgemv_rows_avx512<1>(n, a + i * lda, lda, x, y + i);
+}
+
+#endif // BLAS_X86
+
+// Dispatch ///////////////////////////////////////////////////////////////
+
+//
+//  The AVX2 kernel also needs F16C for float16, which is not part
+//  of the avx2 level; the SSE4 level uses the generic kernel
+//
+template <typename H>
+void
+_hgemv_dispatch(size_t m, size_t n, const H* a, size_t lda, const float* x, float* y)
+{
+#ifdef BLAS_X86
+    switch (cpu::active_isa())
+    {
+    case cpu::isa::avx512:
+        return hgemv_avx512(m, n, a, lda, x, y);
+    case cpu::isa::avx2:
+        if (cpu::detect().f16c) return hgemv_avx2(m, n, a, lda, x, y);
+        break;
+    default:
+        break;
+    }
+#endif
+    hgemv_generic(m, n, a, lda, x, y);
+}
+
+//
+//  y = A * x for half-width A, float x and y
+//
+template <typename H>
+void
+hgemv(size_t m, size_t n, const H* a, size_t lda, const float* x, float* y)
+{
+    parallel_for(0, m, grain::rows(n), [=](size_t begin, size_t end)
+    {
+        _hgemv_dispatch(end - begin, n, a + begin * lda, lda, x, y + begin);
+    });
+}
+
+} // namespace kernel
+} // namespace blas
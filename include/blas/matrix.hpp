@@ -1,7 +1,18 @@
 #pragma once
 
+#include <cassert>
+#include <functional>
+
 #include "blas/allocator.hpp"
+#include "blas/copy.hpp"
+#include "blas/thread_pool.hpp"
+#include "blas/expression.hpp"
+#include "blas/gemm.hpp"
+#include "blas/gemv.hpp"
+#include "blas/ger.hpp"
+#include "blas/spmv.hpp"
 #include "blas/vector.hpp"
+#include "blas/view.hpp"
 
 namespace blas {
 
@@ -9,8 +20,14 @@ namespace blas {
 template <typename T, typename _alloc>
 struct vector;
 
-template <typename T, typename _alloc = allocator<T>>
-struct matrix
+template <typename T, typename _alloc>
+struct transpose_view;
+
+template <typename T>
+struct sparse_vector;
+
+template <typename T, typename _alloc = pool_allocator<T>>
+struct matrix : matrix_expression<matrix<T, _alloc>>
 {
 public:
 
@@ -53,15 +70,12 @@ public:
         fill(fillament);
     }
 
-    matrix(const matrix<T>& m)
+    matrix(const matrix& m)
     :   _height(m._height),
         _width(m._width)
     {
         _data = _allocate(size());
-
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] = m._data[i];
+        kernel::copy(size(), m._data, _data);
     }
 
     matrix(matrix&& m)
@@ -73,6 +87,15 @@ public:
         m._height = 0;
         m._width = 0;
     }
+
+    template <typename E>
+    matrix(const matrix_expression<E>& e)
+    :   _height(e.self().height()),
+        _width(e.self().width())
+    {
+        _data = _allocate(size());
+        _assign(e.self());
+    }
     
     template <typename _T>
     matrix(const matrix<_T>& m, std::function<T(const _T&)> f = [](const _T& x) { return static_cast<T>(x); })
@@ -81,9 +104,11 @@ public:
     {
         _data = _allocate(size());
 
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] = m.data()[i];
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] = m.data()[i];
+        });
     }
     
 // Destructor /////////////////////////////////////////////////////////////
@@ -101,10 +126,7 @@ public:
         if (&m != this)
         {
             resize(m._width, m._height);
-
-            #pragma omp parallel for
-            for (size_type i = 0; i < size(); ++i)
-                _data[i] = m._data[i];
+            kernel::copy(size(), m._data, _data);
         }
         return *this;
     }
@@ -123,6 +145,17 @@ public:
         return *this;
     }
 
+    template <typename E>
+    matrix&
+    operator = (const matrix_expression<E>& e)
+    {
+        // element i of the expression only reads element i of its operands,
+        // so evaluating into a matrix the expression refers to is safe
+        resize(e.self().width(), e.self().height());
+        _assign(e.self());
+        return *this;
+    }
+
 // Resizing method ////////////////////////////////////////////////////////
 
     void
@@ -140,9 +173,7 @@ public:
     void
     fill(const_reference fillament)
     {
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] = fillament;
+        kernel::fill(size(), fillament, _data);
     }
 
 // Row getters ////////////////////////////////////////////////////////////
@@ -197,6 +228,18 @@ public:
         return _data;
     }
 
+    matrix_view<T>
+    view()
+    {
+        return matrix_view<T>(_data, _height, _width, _width);
+    }
+
+    matrix_view<const T>
+    view() const
+    {
+        return matrix_view<const T>(_data, _height, _width, _width);
+    }
+
 // Iterator methods ///////////////////////////////////////////////////////
 
     iterator
@@ -223,101 +266,102 @@ public:
         return _data + size();
     }
 
-// Binary operators ///////////////////////////////////////////////////////
-
-    matrix
-    operator + (const matrix& m) const
-    {
-        matrix result(*this);
-        result += m;
-        return result;
-    }
-
-    matrix
-    operator - (const matrix& m) const
-    {
-        matrix result(*this);
-        result -= m;
-        return result;
-    }
-
-    matrix
-    operator * (const_reference scalar) const
-    {
-        matrix result(*this);
-        result *= scalar;
-        return result;
-    }
-
-    matrix
-    operator / (const_reference scalar) const
-    {
-        matrix result(*this);
-        result /= scalar;
-        return result;
-    }
-
 // Binary mutating operators //////////////////////////////////////////////
+//
+//  Element-wise arithmetic is provided by the lazy operators in
+//  blas/expression.hpp; these evaluate the right hand side in place
+//
 
+    template <typename E>
     matrix&
-    operator += (const matrix& m)
+    operator += (const matrix_expression<E>& e)
     {
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] += m._data[i];
+        const E& m = e.self();
+        assert(_height == m.height() and _width == m.width());
+
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] += element(m, i);
+        });
         return *this;
     }
 
+    template <typename E>
     matrix&
-    operator -= (const matrix& m)
+    operator -= (const matrix_expression<E>& e)
     {
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] -= m._data[i];
+        const E& m = e.self();
+        assert(_height == m.height() and _width == m.width());
+
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] -= element(m, i);
+        });
         return *this;
     }
 
     matrix&
     operator *= (const_reference scalar)
     {
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] *= scalar;
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] *= scalar;
+        });
         return *this;
     }
 
     matrix&
     operator /= (const_reference scalar)
     {
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] /= scalar;
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] /= scalar;
+        });
         return *this;
     }
 
 // Math ///////////////////////////////////////////////////////////////////
 
+    template <typename _valloc>
     vector<T, _alloc>
-    operator * (const vector<T, _alloc>& v) const
+    operator * (const vector<T, _valloc>& v) const
+    {
+        vector<T, _alloc> result;
+        multiply(v, result);
+        return result;
+    }
+
+    //
+    //  y = this * x into an existing vector of any allocator,
+    //  reusing its storage when it is large enough
+    //
+    template <typename _xalloc, typename _yalloc>
+    void
+    multiply(const vector<T, _xalloc>& x, vector<T, _yalloc>& y) const
     {
-        assert(_width == v.size());
+        assert(_width == x.size());
 
-        vector<T, _alloc> result(_height);
+        y.resize(_height);
 
-        #pragma omp parallel for
-        for (size_type i = 0; i < _height; ++i)
-        {
-            auto this_row = row(i);
-
-            value_type sum = 0;
-            #pragma omp parallel for reduction(+:sum)
-            for (size_type j = 0; j < _width; ++j)
-                sum += this_row[j] * v[j];
-                
-            result[i] = sum;
-        }
+        kernel::gemv<value_type>(_height, _width, _data, _width, x.data(), y.data());
+    }
 
-        return result;
+    //
+    //  y = this * x reading only the columns that match the nonzeros of x
+    //
+    template <typename _yalloc>
+    void
+    multiply(const sparse_vector<T>& x, vector<T, _yalloc>& y) const
+    {
+        assert(_width == x.size());
+
+        y.resize(_height);
+
+        kernel::gemv_sparse<value_type>(_height, _data, _width, x.nonzeros(), x.indices(), x.values(), y.data());
     }
 
     matrix
@@ -327,39 +371,88 @@ public:
 
         matrix result(_height, m._width);
 
-        #pragma omp parallel for
-        for (size_type i = 0; i < _height; ++i)
-        {
-            auto result_row = result[i];
-            auto this_row = row(i);
+        kernel::gemm<value_type>(
+            _height, m._width, _width,
+            _data, _width,
+            m._data, m._width,
+            value_type(0), result._data, result._width
+        );
 
-            #pragma omp parallel for
-            for (size_type j = 0; j < m._width; ++j)
-            {
-                value_type sum = 0;
+        return result;
+    }
 
-                #pragma omp parallel for reduction(+:sum)
-                for (size_type k = 0; k < _width; ++k)
-                    sum += this_row[k] * m[k][j];
+    matrix
+    operator * (const transpose_view<T, _alloc>& t) const
+    {
+        const matrix& m = t.transposed();
+        assert(_width == m._width);
 
-                result_row[j] = sum;
-            }
-        }
+        matrix result(_height, m._height);
+
+        kernel::gemm<value_type>(
+            _height, m._height, _width,
+            _data, _width, 1,
+            m._data, 1, m._width,
+            value_type(0), result._data, result._width
+        );
 
         return result;
     }
 
+    //
+    //  this += alpha * x * y^T (BLAS GER), touching every element once
+    //
+    template <typename _xalloc, typename _yalloc>
+    matrix&
+    rank1_update(const_reference alpha, const vector<T, _xalloc>& x, const vector<T, _yalloc>& y)
+    {
+        assert(_height == x.size() and _width == y.size());
+
+        kernel::ger<value_type>(_height, _width, alpha, x.data(), y.data(), _data, _width);
+        return *this;
+    }
+
+    //
+    //  this += alpha * x * y^T writing only the rows of the nonzeros of x
+    //
+    template <typename _yalloc>
+    matrix&
+    rank1_update(const_reference alpha, const sparse_vector<T>& x, const vector<T, _yalloc>& y)
+    {
+        assert(_height == x.size() and _width == y.size());
+
+        kernel::ger_sparse<value_type>(_width, alpha, x.nonzeros(), x.indices(), x.values(), y.data(), _data, _width);
+        return *this;
+    }
+
+    //
+    //  this += alpha * x * y^T writing only the columns of the nonzeros of y
+    //
+    template <typename _xalloc>
+    matrix&
+    rank1_update(const_reference alpha, const vector<T, _xalloc>& x, const sparse_vector<T>& y)
+    {
+        assert(_height == x.size() and _width == y.size());
+
+        kernel::ger_sparse_columns<value_type>(_height, alpha, x.data(), y.nonzeros(), y.indices(), y.values(), _data, _width);
+        return *this;
+    }
+
+    transpose_view<T, _alloc>
+    transposed() const
+    {
+        return transpose_view<T, _alloc>(*this);
+    }
+
     matrix
-    transpose()
+    transpose() const
     {
         matrix result(_width, _height);
 
-        #pragma omp parallel for
         for (size_type y = 0; y < _height; ++y)
         {
             auto this_row = row(y);
-            
-            #pragma omp parallel for
+
             for (size_type x = 0; x < _width; ++x)
                 result[x][y] = this_row[x];
         }
@@ -388,6 +481,17 @@ public:
 
 private:
 
+    template <typename E>
+    void
+    _assign(const E& e)
+    {
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] = element(e, i);
+        });
+    }
+
     static
     pointer
     _allocate(size_type size)
@@ -404,4 +508,122 @@ private:
 
 };
 
+//
+//  Non-owning transposed view of a matrix, returned by matrix::transposed()
+//  Products with a view run the transposed kernels on the original storage
+//  instead of materializing the transpose
+//
+template <typename T, typename _alloc>
+struct transpose_view
+{
+    typedef T           value_type;
+    typedef unsigned    size_type;
+
+private:
+
+    const matrix<T, _alloc>& _matrix;
+
+public:
+
+    explicit
+    transpose_view(const matrix<T, _alloc>& m)
+    :   _matrix(m)
+    {}
+
+    size_type
+    height() const
+    {
+        return _matrix.width();
+    }
+
+    size_type
+    width() const
+    {
+        return _matrix.height();
+    }
+
+    const matrix<T, _alloc>&
+    transposed() const
+    {
+        return _matrix;
+    }
+
+    template <typename _valloc>
+    vector<T, _alloc>
+    operator * (const vector<T, _valloc>& v) const
+    {
+        vector<T, _alloc> result;
+        multiply(v, result);
+        return result;
+    }
+
+    template <typename _xalloc, typename _yalloc>
+    void
+    multiply(const vector<T, _xalloc>& x, vector<T, _yalloc>& y) const
+    {
+        assert(_matrix.height() == x.size());
+
+        y.resize(height());
+
+        kernel::gemv_t<value_type>(_matrix.height(), _matrix.width(), _matrix.data(), _matrix.width(), x.data(), y.data());
+    }
+
+    //
+    //  y = this * x reading only the rows of the underlying matrix
+    //  that match the nonzeros of x
+    //
+    template <typename _yalloc>
+    void
+    multiply(const sparse_vector<T>& x, vector<T, _yalloc>& y) const
+    {
+        assert(_matrix.height() == x.size());
+
+        y.resize(height());
+
+        kernel::gemv_t_sparse<value_type>(_matrix.width(), _matrix.data(), _matrix.width(), x.nonzeros(), x.indices(), x.values(), y.data());
+    }
+
+    matrix<T, _alloc>
+    operator * (const matrix<T, _alloc>& m) const
+    {
+        assert(_matrix.height() == m.height());
+
+        matrix<T, _alloc> result(height(), m.width());
+
+        kernel::gemm<value_type>(
+            height(), m.width(), _matrix.height(),
+            _matrix.data(), 1, _matrix.width(),
+            m.data(), m.width(), 1,
+            value_type(0), result.data(), result.width()
+        );
+
+        return result;
+    }
+
+    matrix<T, _alloc>
+    operator * (const transpose_view& t) const
+    {
+        const matrix<T, _alloc>& m = t.transposed();
+        assert(_matrix.height() == m.width());
+
+        matrix<T, _alloc> result(height(), m.height());
+
+        kernel::gemm<value_type>(
+            height(), m.height(), _matrix.height(),
+            _matrix.data(), 1, _matrix.width(),
+            m.data(), 1, m.width(),
+            value_type(0), result.data(), result.width()
+        );
+
+        return result;
+    }
+};
+
+template <typename T, typename _alloc>
+const T&
+element(const matrix<T, _alloc>& m, unsigned index)
+{
+    return m.data()[index];
+}
+
 } // namespace lm
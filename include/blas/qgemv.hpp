@@ -0,0 +1,265 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "blas/cpu.hpp"
+#include "blas/thread_pool.hpp"
+
+#ifdef BLAS_X86
+#include <immintrin.h>
+#endif
+
+namespace blas {
+namespace kernel {
+
+//
+//  Integer GEMV kernels: y = A * x for row-major int8 A[m x n], int8 x
+//  and int32 y; products are exact, so every kernel gives the same result
+//  Like the floating point kernels they walk R rows per pass sharing the
+//  loads of x
+//
+
+// Generic ////////////////////////////////////////////////////////////////
+
+template <size_t R>
+void
+qgemv_rows_generic(size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y)
+{
+    int32_t acc[R] = {};
+
+    for (size_t j = 0; j < n; ++j)
+        for (size_t r = 0; r < R; ++r)
+            acc[r] += int32_t(a[r * lda + j]) * x[j];
+
+    for (size_t r = 0; r < R; ++r)
+        y[r] = acc[r];
+}
+
+inline
+void
+qgemv_generic(size_t m, size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y)
+{
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4)
+        qgemv_rows_generic<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        qgemv_rows_generic<1>(n, a + i * lda, lda, x, y + i);
+}
+
+#ifdef BLAS_X86
+
+// AVX2 ///////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2")))
+inline
+int32_t
+hsum_epi32_avx2(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+}
+
+//
+//  Widens 16 bytes to int16 and multiplies with vpmaddwd; unlike vpmaddubsw
+//  this can not saturate, whatever the int8 values are
+//
+template <size_t R>
+__attribute__((target("avx2")))
+void
+qgemv_rows_avx2(size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y)
+{
+    __m256i acc[R];
+    for (size_t r = 0; r < R; ++r)
+        acc[r] = _mm256_setzero_si256();
+
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        const __m256i xv = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + j)));
+
+        for (size_t r = 0; r < R; ++r)
+        {
+            const __m256i av = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + r * lda + j)));
+            acc[r] = _mm256_add_epi32(acc[r], _mm256_madd_epi16(av, xv));
+        }
+    }
+
+    for (size_t r = 0; r < R; ++r)
+    {
+        int32_t sum = hsum_epi32_avx2(acc[r]);
+        for (size_t k = j; k < n; ++k)
+            sum += int32_t(a[r * lda + k]) * x[k];
+        y[r] = sum;
+    }
+}
+
+// AVX-512 ////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx512f")))
+inline
+int32_t
+hsum_epi32_avx512(__m512i v)
+{
+    const __m256i s8 = _mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xff, v, 0), _mm512_maskz_extracti64x4_epi64(0xff, v, 1));
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(s8), _mm256_extracti128_si256(s8, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+}
+
+template <size_t R>
+__attribute__((target("avx512f,avx512bw")))
+void
+qgemv_rows_avx512bw(size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y)
+{
+    __m512i acc[R];
+    for (size_t r = 0; r < R; ++r)
+        acc[r] = _mm512_setzero_si512();
+
+    size_t j = 0;
+    for (; j + 32 <= n; j += 32)
+    {
+        const __m512i xv = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + j)));
+
+        for (size_t r = 0; r < R; ++r)
+        {
+            const __m512i av = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + r * lda + j)));
+            acc[r] = _mm512_add_epi32(acc[r], _mm512_madd_epi16(av, xv));
+        }
+    }
+
+    for (size_t r = 0; r < R; ++r)
+    {
+        int32_t sum = hsum_epi32_avx512(acc[r]);
+        for (size_t k = j; k < n; ++k)
+            sum += int32_t(a[r * lda + k]) * x[k];
+        y[r] = sum;
+    }
+}
+
+//
+//  vpdpbusd multiplies unsigned by signed bytes, so x is biased by 128
+//  (a sign bit flip) and the result is sum(A(i, j) * x(j)) + 128 * sum(A(i, j));
+//  the driver removes the bias with the precomputed row sums
+//
+template <size_t R>
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+void
+qgemv_rows_avx512vnni(size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y)
+{
+    const __m512i bias = _mm512_set1_epi8(char(0x80));
+
+    __m512i acc[R];
+    for (size_t r = 0; r < R; ++r)
+        acc[r] = _mm512_setzero_si512();
+
+    size_t j = 0;
+    for (; j + 64 <= n; j += 64)
+    {
+        const __m512i xv = _mm512_xor_si512(_mm512_loadu_si512(x + j), bias);
+
+        for (size_t r = 0; r < R; ++r)
+            acc[r] = _mm512_dpbusd_epi32(acc[r], xv, _mm512_loadu_si512(a + r * lda + j));
+    }
+    if (j < n)
+    {
+        // masked out bytes of A are zero, so the biased x there adds nothing
+        const __mmask64 mask = _cvtu64_mask64(~0ull >> (64 - (n - j)));
+        const __m512i xv = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, x + j), bias);
+
+        for (size_t r = 0; r < R; ++r)
+            acc[r] = _mm512_dpbusd_epi32(acc[r], xv, _mm512_maskz_loadu_epi8(mask, a + r * lda + j));
+    }
+
+    for (size_t r = 0; r < R; ++r)
+        y[r] = hsum_epi32_avx512(acc[r]);
+}
+
+// Drivers ////////////////////////////////////////////////////////////////
+
+inline
+void
+qgemv_avx2(size_t m, size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y)
+{
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4)
+        qgemv_rows_avx2<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        qgemv_rows_avx2<1>(n, a + i * lda, lda, x, y + i);
+}
+
+inline
+void
+qgemv_avx512bw(size_t m, size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y)
+{
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4)
+        qgemv_rows_avx512bw<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        qgemv_rows_avx512bw<1>(n, a + i * lda, lda, x, y + i);
+}
+
+inline
+void
+qgemv_avx512vnni(size_t m, size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y, const int32_t* row_sums)
+{
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4)
+        qgemv_rows_avx512vnni<4>(n, a + i * lda, lda, x, y + i);
+    for (; i < m; ++i)
+        qgemv_rows_avx512vnni<1>(n, a + i * lda, lda, x, y + i);
+
+    for (i = 0; i < m; ++i)
+        y[i] -= 128 * row_sums[i];
+}
+
+#endif // BLAS_X86
+
+// Dispatch ///////////////////////////////////////////////////////////////
+
+//
+//  The int8 kernels need AVX-512BW / VNNI on top of the avx512 level;
+//  without them the level falls back to the AVX2 kernel
+//
+inline
+void
+_qgemv_dispatch(size_t m, size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y, const int32_t* row_sums)
+{
+#ifdef BLAS_X86
+    const cpu::features& f = cpu::detect();
+
+    switch (cpu::active_isa())
+    {
+    case cpu::isa::avx512:
+        if (f.avx512bw and f.avx512vnni) return qgemv_avx512vnni(m, n, a, lda, x, y, row_sums);
+        if (f.avx512bw)                  return qgemv_avx512bw(m, n, a, lda, x, y);
+        return qgemv_avx2(m, n, a, lda, x, y);
+    case cpu::isa::avx2:
+        return qgemv_avx2(m, n, a, lda, x, y);
+    default:
+        break;
+    }
+#endif
+    (void)row_sums;
+    qgemv_generic(m, n, a, lda, x, y);
+}
+
+//
+//  y = A * x in int8 with int32 accumulation
+//  row_sums[i] must hold the sum of row i of A, the VNNI kernel needs it
+//
+inline
+void
+qgemv(size_t m, size_t n, const int8_t* a, size_t lda, const int8_t* x, int32_t* y, const int32_t* row_sums)
+{
+    parallel_for(0, m, grain::rows(n), [=](size_t begin, size_t end)
+    {
+        _qgemv_dispatch(end - begin, n, a + begin * lda, lda, x, y + begin, row_sums + begin);
+    });
+}
+
+} // namespace kernel
+} // namespace blas
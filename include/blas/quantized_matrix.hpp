@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+#include "blas/qgemv.hpp"
+#include "blas/vector.hpp"
+#include "blas/matrix.hpp"
+
+namespace blas {
+
+//
+//  Symmetric int8 quantization of n values: q = round(x / scale)
+//  with scale = max|x| / 127; returns the scale, 0 for an all-zero input
+//
+template <typename T>
+T
+quantize(size_t n, const T* x, int8_t* q)
+{
+    T max = T(0);
+    for (size_t i = 0; i < n; ++i)
+        max = std::fabs(x[i]) > max ? std::fabs(x[i]) : max;
+
+    if (max == T(0))
+    {
+        for (size_t i = 0; i < n; ++i)
+            q[i] = 0;
+        return T(0);
+    }
+
+    const T scale = max / T(127);
+    const T inverse = T(127) / max;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const long v = std::lround(x[i] * inverse);
+        q[i] = int8_t(v > 127 ? 127 : v < -127 ? -127 : v);
+    }
+
+    return scale;
+}
+
+//
+//  Read-only int8 copy of a matrix for inference
+//  Every row keeps its own scale, rows are padded to a multiple of 64 bytes;
+//  products quantize x on the fly, accumulate in int32 and scale back to T
+//
+template <typename T>
+struct quantized_matrix
+{
+public:
+
+    typedef T           value_type;
+    typedef unsigned    size_type;
+
+protected:
+
+    vector<int8_t>  _data;
+    vector<T>       _scales;
+    vector<int32_t> _row_sums;
+    size_type _height, _width, _stride;
+
+public:
+
+// Constructors ///////////////////////////////////////////////////////////
+
+    quantized_matrix()
+    :   _height(0),
+        _width(0),
+        _stride(0)
+    {}
+
+    template <typename _alloc>
+    explicit
+    quantized_matrix(const matrix<T, _alloc>& m)
+    :   _data((m.width() + 63) / 64 * 64 * m.height()),
+        _scales(m.height()),
+        _row_sums(m.height()),
+        _height(m.height()),
+        _width(m.width()),
+        _stride((m.width() + 63) / 64 * 64)
+    {
+        parallel_for(0, _height, grain::rows(_width), [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                int8_t* row = _data.data() + i * _stride;
+                _scales[i] = quantize<T>(_width, m.data() + i * _width, row);
+
+                for (size_type j = _width; j < _stride; ++j)
+                    row[j] = 0;
+
+                int32_t sum = 0;
+                for (size_type j = 0; j < _width; ++j)
+                    sum += row[j];
+                _row_sums[i] = sum;
+            }
+        });
+    }
+
+// Attributes getters /////////////////////////////////////////////////////
+
+    size_type
+    height() const
+    {
+        return _height;
+    }
+
+    size_type
+    width() const
+    {
+        return _width;
+    }
+
+    //
+    //  Bytes of weights and scales a product streams
+    //
+    size_t
+    bytes() const
+    {
+        return size_t(_height) * _stride + _height * (sizeof(T) + sizeof(int32_t));
+    }
+
+    const vector<T>&
+    scales() const
+    {
+        return _scales;
+    }
+
+// Math ///////////////////////////////////////////////////////////////////
+
+    template <typename _xalloc, typename _yalloc>
+    void
+    multiply(const vector<T, _xalloc>& x, vector<T, _yalloc>& y) const
+    {
+        assert(_width == x.size());
+
+        static thread_local vector<int8_t> qx;
+        static thread_local vector<int32_t> acc;
+
+        qx.resize(_width);
+        acc.resize(_height);
+
+        const T x_scale = quantize<T>(_width, x.data(), qx.data());
+
+        kernel::qgemv(_height, _width, _data.data(), _stride, qx.data(), acc.data(), _row_sums.data());
+
+        y.resize(_height);
+        for (size_type i = 0; i < _height; ++i)
+            y[i] = T(acc[i]) * (_scales[i] * x_scale);
+    }
+
+    template <typename _valloc>
+    vector<T>
+    operator * (const vector<T, _valloc>& v) const
+    {
+        vector<T> result;
+        multiply(v, result);
+        return result;
+    }
+};
+
+} // namespace blas
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "blas/gemv.hpp"
+#include "blas/ger.hpp"
+#include "blas/spmv.hpp"
+
+namespace blas {
+namespace kernel {
+
+//
+//  Kernels over memory that other threads update at the same time, as in
+//  Hogwild! training, where an update may overwrite another's
+//
+//  By default they are the ordinary kernels, vectorized and split across the
+//  pool, on shared memory without synchronization. That is a data race by
+//  the letter of the C++ memory model, and a benign one: the weights are
+//  naturally aligned, and x86 reads and writes every aligned element of a
+//  vector access whole, so a concurrent update may be lost, never torn.
+//  A single thread computes exactly what the ordinary kernels do
+//
+//  With BLAS_HOGWILD_STRICT defined every element of a shared operand is
+//  read and written with a relaxed atomic access instead, which is free of
+//  races, e.g. for ThreadSanitizer, but scalar and on the calling thread
+//
+
+#ifndef BLAS_HOGWILD_STRICT
+
+//
+//  y = A * x for shared A[m x n] given by row and column strides, one of
+//  them 1
+//
+template <typename T>
+void
+relaxed_gemv(size_t m, size_t n, const T* a, size_t rsa, size_t csa, const T* x, T* y)
+{
+    if (csa == 1)
+        gemv<T>(m, n, a, rsa, x, y);
+    else
+        // a transposed row-major block
+        gemv_t<T>(n, m, a, csa, x, y);
+}
+
+//
+//  A += alpha * x * y^T for shared A[m x n] given by row and column strides,
+//  one of them 1
+//
+template <typename T>
+void
+relaxed_ger(size_t m, size_t n, T alpha, const T* x, const T* y, T* a, size_t rsa, size_t csa)
+{
+    if (csa == 1)
+        ger<T>(m, n, alpha, x, y, a, rsa);
+    else
+        // the transpose is row-major: A^T += alpha * y * x^T
+        ger<T>(n, m, alpha, y, x, a, csa);
+}
+
+//
+//  Shared y += alpha * x
+//
+template <typename T>
+void
+relaxed_axpy(size_t n, T alpha, const T* x, T* y)
+{
+    axpy<T>(n, alpha, x, y);
+}
+
+//
+//  y += shared x
+//
+template <typename T>
+void
+relaxed_add(size_t n, const T* x, T* y)
+{
+    for (size_t j = 0; j < n; ++j)
+        y[j] += x[j];
+}
+
+//
+//  y = A^T * x for shared row-major A[m x n] and x given by its nonzeros
+//
+template <typename T>
+void
+relaxed_gemv_t_sparse(size_t n, const T* a, size_t lda, size_t nonzeros, const uint32_t* indices, const T* values, T* y)
+{
+    gemv_t_sparse<T>(n, a, lda, nonzeros, indices, values, y);
+}
+
+//
+//  A += alpha * x * y^T for shared row-major A[m x n] and x given by its
+//  nonzeros
+//
+template <typename T>
+void
+relaxed_ger_sparse(size_t n, T alpha, size_t nonzeros, const uint32_t* indices, const T* values, const T* y, T* a, size_t lda)
+{
+    ger_sparse<T>(n, alpha, nonzeros, indices, values, y, a, lda);
+}
+
+//
+//  y = A * x for shared row-major A[m x n] and x given by its nonzeros
+//
+template <typename T>
+void
+relaxed_gemv_sparse(size_t m, const T* a, size_t lda, size_t nonzeros, const uint32_t* indices, const T* values, T* y)
+{
+    gemv_sparse<T>(m, a, lda, nonzeros, indices, values, y);
+}
+
+//
+//  A += alpha * x * y^T for shared row-major A[m x n] and y given by its
+//  nonzeros
+//
+template <typename T>
+void
+relaxed_ger_sparse_columns(size_t m, T alpha, const T* x, size_t nonzeros, const uint32_t* indices, const T* values, T* a, size_t lda)
+{
+    ger_sparse_columns<T>(m, alpha, x, nonzeros, indices, values, a, lda);
+}
+
+#else // BLAS_HOGWILD_STRICT
+
+//
+//  The same loops with every shared element behind a relaxed atomic
+//
+
+template <typename T>
+inline
+T
+relaxed_load(const T* p)
+{
+    T value;
+    __atomic_load(p, &value, __ATOMIC_RELAXED);
+    return value;
+}
+
+template <typename T>
+inline
+void
+relaxed_store(T* p, T value)
+{
+    __atomic_store(p, &value, __ATOMIC_RELAXED);
+}
+
+//
+//  y = A * x for shared A[m x n] given by row and column strides
+//
+template <typename T>
+void
+relaxed_gemv(size_t m, size_t n, const T* a, size_t rsa, size_t csa, const T* x, T* y)
+{
+    if (csa == 1)
+    {
+        for (size_t i = 0; i < m; ++i)
+        {
+            const T* row = a + i * rsa;
+
+            // four chains, a single one waits on the latency of every add
+            T s0 = T(0), s1 = T(0), s2 = T(0), s3 = T(0);
+            size_t j = 0;
+            for (; j < n / 4 * 4; j += 4)
+            {
+                s0 += relaxed_load(row + j) * x[j];
+                s1 += relaxed_load(row + j + 1) * x[j + 1];
+                s2 += relaxed_load(row + j + 2) * x[j + 2];
+                s3 += relaxed_load(row + j + 3) * x[j + 3];
+            }
+            for (; j < n; ++j)
+                s0 += relaxed_load(row + j) * x[j];
+
+            y[i] = (s0 + s1) + (s2 + s3);
+        }
+        return;
+    }
+
+    // columns are contiguous, sum them scaled into y
+    for (size_t i = 0; i < m; ++i)
+        y[i] = T(0);
+
+    for (size_t j = 0; j < n; ++j)
+    {
+        const T* column = a + j * csa;
+        const T xj = x[j];
+
+        for (size_t i = 0; i < m; ++i)
+            y[i] += relaxed_load(column + i * rsa) * xj;
+    }
+}
+
+//
+//  A += alpha * x * y^T for shared A[m x n] given by row and column strides
+//
+template <typename T>
+void
+relaxed_ger(size_t m, size_t n, T alpha, const T* x, const T* y, T* a, size_t rsa, size_t csa)
+{
+    if (csa == 1)
+    {
+        for (size_t i = 0; i < m; ++i)
+        {
+            const T coefficient = alpha * x[i];
+            if (coefficient == T(0)) continue;
+
+            T* row = a + i * rsa;
+            for (size_t j = 0; j < n; ++j)
+                relaxed_store(row + j, relaxed_load(row + j) + coefficient * y[j]);
+        }
+        return;
+    }
+
+    for (size_t j = 0; j < n; ++j)
+    {
+        const T coefficient = alpha * y[j];
+        if (coefficient == T(0)) continue;
+
+        T* column = a + j * csa;
+        for (size_t i = 0; i < m; ++i)
+            relaxed_store(column + i * rsa, relaxed_load(column + i * rsa) + coefficient * x[i]);
+    }
+}
+
+//
+//  Shared y += alpha * x
+//
+template <typename T>
+void
+relaxed_axpy(size_t n, T alpha, const T* x, T* y)
+{
+    for (size_t j = 0; j < n; ++j)
+        relaxed_store(y + j, relaxed_load(y + j) + alpha * x[j]);
+}
+
+//
+//  y += shared x
+//
+template <typename T>
+void
+relaxed_add(size_t n, const T* x, T* y)
+{
+    for (size_t j = 0; j < n; ++j)
+        y[j] += relaxed_load(x + j);
+}
+
+//
+//  y = A^T * x for shared row-major A[m x n] and x given by its nonzeros;
+//  only the listed rows of A are read, see gemv_t_sparse
+//
+template <typename T>
+void
+relaxed_gemv_t_sparse(size_t n, const T* a, size_t lda, size_t nonzeros, const uint32_t* indices, const T* values, T* y)
+{
+    for (size_t j = 0; j < n; ++j)
+        y[j] = T(0);
+
+    for (size_t k = 0; k < nonzeros; ++k)
+    {
+        const T xk = values[k];
+        const T* row = a + indices[k] * lda;
+
+        for (size_t j = 0; j < n; ++j)
+            y[j] += xk * relaxed_load(row + j);
+    }
+}
+
+//
+//  A += alpha * x * y^T for shared row-major A[m x n] and x given by its
+//  nonzeros; only the listed rows of A are written, see ger_sparse
+//
+template <typename T>
+void
+relaxed_ger_sparse(size_t n, T alpha, size_t nonzeros, const uint32_t* indices, const T* values, const T* y, T* a, size_t lda)
+{
+    for (size_t k = 0; k < nonzeros; ++k)
+        relaxed_axpy(n, alpha * values[k], y, a + indices[k] * lda);
+}
+
+//
+//  y = A * x for shared row-major A[m x n] and x given by its nonzeros;
+//  every row gathers the columns of the nonzeros, see gemv_sparse
+//
+template <typename T>
+void
+relaxed_gemv_sparse(size_t m, const T* a, size_t lda, size_t nonzeros, const uint32_t* indices, const T* values, T* y)
+{
+    for (size_t i = 0; i < m; ++i)
+    {
+        const T* row = a + i * lda;
+
+        T sum = T(0);
+        for (size_t k = 0; k < nonzeros; ++k)
+            sum += values[k] * relaxed_load(row + indices[k]);
+        y[i] = sum;
+    }
+}
+
+//
+//  A += alpha * x * y^T for shared row-major A[m x n] and y given by its
+//  nonzeros; only the listed columns of A are written, see ger_sparse_columns
+//
+template <typename T>
+void
+relaxed_ger_sparse_columns(size_t m, T alpha, const T* x, size_t nonzeros, const uint32_t* indices, const T* values, T* a, size_t lda)
+{
+    for (size_t i = 0; i < m; ++i)
+    {
+        const T ax = alpha * x[i];
+        T* row = a + i * lda;
+
+        for (size_t k = 0; k < nonzeros; ++k)
+            relaxed_store(row + indices[k], relaxed_load(row + indices[k]) + ax * values[k]);
+    }
+}
+
+#endif // BLAS_HOGWILD_STRICT
+
+} // namespace kernel
+} // namespace blas
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+#include "blas/spmv.hpp"
+#include "blas/vector.hpp"
+#include "blas/matrix.hpp"
+
+namespace blas {
+
+//
+//  Read-only copy of a matrix in compressed sparse rows, built by magnitude
+//  pruning: only the largest |a(i, j)| are kept, the rest count as zero
+//  Products cost and storage are proportional to the number of nonzeros
+//
+template <typename T>
+struct sparse_matrix
+{
+public:
+
+    typedef T           value_type;
+    typedef unsigned    size_type;
+
+protected:
+
+    vector<T>           _values;
+    vector<uint32_t>    _columns;
+    vector<size_t>      _offsets;
+    size_type _height, _width;
+
+public:
+
+// Constructors ///////////////////////////////////////////////////////////
+
+    sparse_matrix()
+    :   _offsets(1),
+        _height(0),
+        _width(0)
+    {
+        _offsets[0] = 0;
+    }
+
+    //
+    //  Keeps the density * size() weights of largest magnitude, ties broken
+    //  in row-major order; exact zeros are never stored
+    //
+    template <typename _alloc>
+    explicit
+    sparse_matrix(const matrix<T, _alloc>& m, double density = 1.0)
+    :   _offsets(m.height() + 1),
+        _height(m.height()),
+        _width(m.width())
+    {
+        const size_t size = m.size();
+        const size_t keep = std::min<size_t>(size, size_t(std::ceil(std::max(density, 0.0) * size)));
+
+        // magnitude of the keep-th largest weight
+        T threshold = keep ? T(0) : std::numeric_limits<T>::infinity();
+        if (keep > 0 and keep < size)
+        {
+            vector<T> magnitudes(size);
+            for (size_t i = 0; i < size; ++i)
+                magnitudes[i] = std::fabs(m.data()[i]);
+
+            std::nth_element(magnitudes.begin(), magnitudes.begin() + (keep - 1), magnitudes.end(), std::greater<T>());
+            threshold = magnitudes[keep - 1];
+        }
+
+        // every weight above the threshold, then ties while there is room
+        size_t above = 0;
+        for (size_t i = 0; i < size; ++i)
+            above += std::fabs(m.data()[i]) > threshold;
+        size_t ties = keep > above ? keep - above : 0;
+
+        _values.resize(keep);
+        _columns.resize(keep);
+
+        size_t nonzeros = 0;
+        _offsets[0] = 0;
+        for (size_type i = 0; i < _height; ++i)
+        {
+            for (size_type j = 0; j < _width; ++j)
+            {
+                const T a = m[i][j];
+                const T magnitude = std::fabs(a);
+
+                bool kept = magnitude > threshold;
+                if (!kept and magnitude == threshold and ties > 0)
+                {
+                    kept = true;
+                    --ties;
+                }
+
+                if (kept and a != T(0))
+                {
+                    _values[nonzeros] = a;
+                    _columns[nonzeros] = j;
+                    ++nonzeros;
+                }
+            }
+            _offsets[i + 1] = nonzeros;
+        }
+
+        _values.resize(nonzeros);
+        _columns.resize(nonzeros);
+    }
+
+// Attributes getters /////////////////////////////////////////////////////
+
+    size_type
+    height() const
+    {
+        return _height;
+    }
+
+    size_type
+    width() const
+    {
+        return _width;
+    }
+
+    size_t
+    nonzeros() const
+    {
+        return _offsets[_height];
+    }
+
+    //
+    //  Fraction of the dense matrix that is stored
+    //
+    double
+    density() const
+    {
+        return _height and _width ? double(nonzeros()) / (double(_height) * _width) : 0.0;
+    }
+
+    //
+    //  Bytes of values and indices a product streams
+    //
+    size_t
+    bytes() const
+    {
+        return nonzeros() * (sizeof(T) + sizeof(uint32_t)) + (size_t(_height) + 1) * sizeof(size_t);
+    }
+
+    const vector<T>&
+    values() const
+    {
+        return _values;
+    }
+
+    const vector<uint32_t>&
+    columns() const
+    {
+        return _columns;
+    }
+
+    const vector<size_t>&
+    offsets() const
+    {
+        return _offsets;
+    }
+
+// Math ///////////////////////////////////////////////////////////////////
+
+    template <typename _xalloc, typename _yalloc>
+    void
+    multiply(const vector<T, _xalloc>& x, vector<T, _yalloc>& y) const
+    {
+        assert(_width == x.size());
+
+        y.resize(_height);
+        kernel::spmv(_height, _offsets.data(), _columns.data(), _values.data(), x.data(), y.data());
+    }
+
+    template <typename _valloc>
+    vector<T>
+    operator * (const vector<T, _valloc>& v) const
+    {
+        vector<T> result;
+        multiply(v, result);
+        return result;
+    }
+};
+
+} // namespace blas
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+
+#include "blas/vector.hpp"
+
+namespace blas {
+
+//
+//  Nonzero entries of a dense vector as an index list and the matching
+//  values, for inputs that are mostly exact zeros such as image pixels
+//  Built once per sample; products with a matrix touch only the listed
+//  columns
+//
+template <typename T>
+struct sparse_vector
+{
+public:
+
+    typedef T           value_type;
+    typedef unsigned    size_type;
+
+protected:
+
+    vector<uint32_t>    _indices;
+    vector<T>           _values;
+    size_type _size;
+
+public:
+
+// Constructors ///////////////////////////////////////////////////////////
+
+    sparse_vector()
+    :   _size(0)
+    {}
+
+    template <typename _alloc>
+    explicit
+    sparse_vector(const vector<T, _alloc>& v)
+    :   _size(0)
+    {
+        assign(v);
+    }
+
+// Assignment /////////////////////////////////////////////////////////////
+
+    //
+    //  Rebuilds the index list from a dense vector
+    //
+    template <typename _alloc>
+    void
+    assign(const vector<T, _alloc>& v)
+    {
+        size_type nonzeros = 0;
+        for (size_type i = 0; i < v.size(); ++i)
+            nonzeros += v[i] != T(0);
+
+        _size = v.size();
+        _indices.resize(nonzeros);
+        _values.resize(nonzeros);
+
+        size_type k = 0;
+        for (size_type i = 0; i < v.size(); ++i)
+        {
+            if (v[i] != T(0))
+            {
+                _indices[k] = i;
+                _values[k] = v[i];
+                ++k;
+            }
+        }
+    }
+
+// Attributes getters /////////////////////////////////////////////////////
+
+    //
+    //  Length of the dense vector
+    //
+    size_type
+    size() const
+    {
+        return _size;
+    }
+
+    size_type
+    nonzeros() const
+    {
+        return _indices.size();
+    }
+
+    const uint32_t*
+    indices() const
+    {
+        return _indices.data();
+    }
+
+    const T*
+    values() const
+    {
+        return _values.data();
+    }
+};
+
+} // namespace blas
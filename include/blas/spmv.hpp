@@ -0,0 +1,354 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "blas/cpu.hpp"
+#include "blas/dispatch.hpp"
+#include "blas/gemv.hpp"
+#include "blas/thread_pool.hpp"
+
+#ifdef BLAS_X86
+#include <immintrin.h>
+#endif
+
+namespace blas {
+namespace kernel {
+
+//
+//  Sparse GEMV kernels: y = A * x for A[m x n] in compressed sparse rows
+//  Row i holds values[offsets[i] .. offsets[i + 1]) at the matching columns;
+//  x is dense and read through the column indices, the SIMD kernels
+//  gather a register of x per step
+//
+
+// Generic ////////////////////////////////////////////////////////////////
+
+template <typename T>
+void
+spmv_generic(size_t m, const size_t* offsets, const uint32_t* columns, const T* values, const T* x, T* y)
+{
+    for (size_t i = 0; i < m; ++i)
+    {
+        T acc[4] = {};
+
+        size_t k = offsets[i];
+        const size_t end = offsets[i + 1];
+        for (; k + 4 <= end; k += 4)
+        {
+            acc[0] += values[k] * x[columns[k]];
+            acc[1] += values[k + 1] * x[columns[k + 1]];
+            acc[2] += values[k + 2] * x[columns[k + 2]];
+            acc[3] += values[k + 3] * x[columns[k + 3]];
+        }
+        for (; k < end; ++k)
+            acc[0] += values[k] * x[columns[k]];
+
+        y[i] = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+}
+
+#ifdef BLAS_X86
+
+// AVX2 ///////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2,fma")))
+inline
+void
+spmv_avx2(size_t m, const size_t* offsets, const uint32_t* columns, const double* values, const double* x, double* y)
+{
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+    for (size_t i = 0; i < m; ++i)
+    {
+        __m256d acc = _mm256_setzero_pd();
+
+        size_t k = offsets[i];
+        const size_t end = offsets[i + 1];
+        for (; k + 4 <= end; k += 4)
+        {
+            const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + k));
+            acc = _mm256_fmadd_pd(_mm256_loadu_pd(values + k), _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, index, all, 8), acc);
+        }
+
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+        double sum = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+        for (; k < end; ++k)
+            sum += values[k] * x[columns[k]];
+        y[i] = sum;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline
+void
+spmv_avx2(size_t m, const size_t* offsets, const uint32_t* columns, const float* values, const float* x, float* y)
+{
+    for (size_t i = 0; i < m; ++i)
+    {
+        __m256 acc = _mm256_setzero_ps();
+
+        size_t k = offsets[i];
+        const size_t end = offsets[i + 1];
+        for (; k + 8 <= end; k += 8)
+        {
+            const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + k));
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(values + k), _mm256_i32gather_ps(x, index, 4), acc);
+        }
+
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        float sum = _mm_cvtss_f32(s);
+        for (; k < end; ++k)
+            sum += values[k] * x[columns[k]];
+        y[i] = sum;
+    }
+}
+
+// AVX-512 ////////////////////////////////////////////////////////////////
+
+//
+//  Tails are masked, so a row of any length takes no scalar steps
+//  Gathers use the masked forms to avoid GCC's uninitialized-register warning
+//
+__attribute__((target("avx512f")))
+inline
+void
+spmv_avx512(size_t m, const size_t* offsets, const uint32_t* columns, const double* values, const double* x, double* y)
+{
+    for (size_t i = 0; i < m; ++i)
+    {
+        __m512d acc = _mm512_setzero_pd();
+
+        size_t k = offsets[i];
+        const size_t end = offsets[i + 1];
+        for (; k + 8 <= end; k += 8)
+        {
+            const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + k));
+            const __m512d xs = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xff, index, x, 8);
+            acc = _mm512_fmadd_pd(_mm512_loadu_pd(values + k), xs, acc);
+        }
+        if (k < end)
+        {
+            const __mmask8 mask = __mmask8((1u << (end - k)) - 1);
+            const __m512i index = _mm512_maskz_loadu_epi32(mask, columns + k);
+            const __m512d xs = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, _mm512_maskz_extracti64x4_epi64(0xff, index, 0), x, 8);
+            acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, values + k), xs, acc);
+        }
+
+        y[i] = hsum_avx512(acc);
+    }
+}
+
+__attribute__((target("avx512f")))
+inline
+void
+spmv_avx512(size_t m, const size_t* offsets, const uint32_t* columns, const float* values, const float* x, float* y)
+{
+    for (size_t i = 0; i < m; ++i)
+    {
+        __m512 acc = _mm512_setzero_ps();
+
+        size_t k = offsets[i];
+        const size_t end = offsets[i + 1];
+        for (; k + 16 <= end; k += 16)
+        {
+            const __m512i index = _mm512_loadu_si512(columns + k);
+            const __m512 xs = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xffff, index, x, 4);
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(values + k), xs, acc);
+        }
+        if (k < end)
+        {
+            const __mmask16 mask = __mmask16((1u << (end - k)) - 1);
+            const __m512i index = _mm512_maskz_loadu_epi32(mask, columns + k);
+            const __m512 xs = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, index, x, 4);
+            acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, values + k), xs, acc);
+        }
+
+        y[i] = hsum_avx512(acc);
+    }
+}
+
+#endif // BLAS_X86
+
+// Dispatch ///////////////////////////////////////////////////////////////
+
+template <typename T>
+void
+_spmv_dispatch(size_t m, const size_t* offsets, const uint32_t* columns, const T* values, const T* x, T* y)
+{
+#ifdef BLAS_X86
+    switch (cpu::active_isa())
+    {
+    case cpu::isa::avx512:  return spmv_avx512(m, offsets, columns, values, x, y);
+    case cpu::isa::avx2:    return spmv_avx2(m, offsets, columns, values, x, y);
+    default:                break;
+    }
+#endif
+    spmv_generic(m, offsets, columns, values, x, y);
+}
+
+template <typename T>
+void
+_spmv_serial(size_t m, const size_t* offsets, const uint32_t* columns, const T* values, const T* x, T* y)
+{
+    spmv_generic(m, offsets, columns, values, x, y);
+}
+
+inline
+void
+_spmv_serial(size_t m, const size_t* offsets, const uint32_t* columns, const float* values, const float* x, float* y)
+{
+    _spmv_dispatch(m, offsets, columns, values, x, y);
+}
+
+inline
+void
+_spmv_serial(size_t m, const size_t* offsets, const uint32_t* columns, const double* values, const double* x, double* y)
+{
+    _spmv_dispatch(m, offsets, columns, values, x, y);
+}
+
+//
+//  y = A * x for a CSR matrix with m rows; rows are split across the pool
+//  by the average number of nonzeros per row
+//
+template <typename T>
+void
+spmv(size_t m, const size_t* offsets, const uint32_t* columns, const T* values, const T* x, T* y)
+{
+    const size_t nonzeros = m ? offsets[m] - offsets[0] : 0;
+
+    parallel_for(0, m, grain::rows(m ? nonzeros / m : 0), [=](size_t begin, size_t end)
+    {
+        _spmv_serial(end - begin, offsets + begin, columns, values, x, y + begin);
+    });
+}
+
+// Sparse x //////////////////////////////////////////////////////////////
+
+//
+//  y = A^T * x for row-major A[m x n] and x given by its nonzeros (indices
+//  into the m rows); only the listed rows of A are read, each one contiguous,
+//  four per pass as in gemv_t
+//
+struct gemv_t_sparse_kernel
+{
+    template <typename T>
+    static inline __attribute__((always_inline))
+    void
+    run(size_t n, const T* a, size_t lda, size_t nonzeros, const uint32_t* indices, const T* values, T* __restrict y)
+    {
+        for (size_t j = 0; j < n; ++j)
+            y[j] = T(0);
+
+        size_t k = 0;
+        for (; k + 4 <= nonzeros; k += 4)
+        {
+            const T x0 = values[k], x1 = values[k + 1], x2 = values[k + 2], x3 = values[k + 3];
+            const T* __restrict a0 = a + indices[k] * lda;
+            const T* __restrict a1 = a + indices[k + 1] * lda;
+            const T* __restrict a2 = a + indices[k + 2] * lda;
+            const T* __restrict a3 = a + indices[k + 3] * lda;
+
+            for (size_t j = 0; j < n; ++j)
+                y[j] += x0 * a0[j] + x1 * a1[j] + x2 * a2[j] + x3 * a3[j];
+        }
+        for (; k < nonzeros; ++k)
+        {
+            const T xk = values[k];
+            const T* __restrict ak = a + indices[k] * lda;
+
+            for (size_t j = 0; j < n; ++j)
+                y[j] += xk * ak[j];
+        }
+    }
+};
+
+template <typename T>
+void
+gemv_t_sparse(size_t n, const T* a, size_t lda, size_t nonzeros, const uint32_t* indices, const T* values, T* y)
+{
+    const size_t columns = (grain::rows(nonzeros) + 63) / 64 * 64;
+
+    parallel_for(0, n, columns, [=](size_t begin, size_t end)
+    {
+        dispatch<gemv_t_sparse_kernel>(end - begin, a + begin, lda, nonzeros, indices, values, y + begin);
+    });
+}
+
+//
+//  A += alpha * x * y^T for row-major A[m x n] and x given by its nonzeros;
+//  only the listed rows of A are written
+//
+struct ger_sparse_kernel
+{
+    template <typename T>
+    static inline __attribute__((always_inline))
+    void
+    run(size_t n, T alpha, size_t nonzeros, const uint32_t* indices, const T* values, const T* __restrict y, T* a, size_t lda)
+    {
+        for (size_t k = 0; k < nonzeros; ++k)
+        {
+            const T ax = alpha * values[k];
+            T* __restrict row = a + indices[k] * lda;
+
+            for (size_t j = 0; j < n; ++j)
+                row[j] += ax * y[j];
+        }
+    }
+};
+
+template <typename T>
+void
+ger_sparse(size_t n, T alpha, size_t nonzeros, const uint32_t* indices, const T* values, const T* y, T* a, size_t lda)
+{
+    // indices are distinct, so the listed rows split across the pool
+    parallel_for(0, nonzeros, grain::rows(n), [=](size_t begin, size_t end)
+    {
+        dispatch<ger_sparse_kernel>(n, alpha, end - begin, indices + begin, values + begin, y, a, lda);
+    });
+}
+
+//
+//  y = A * x for row-major A[m x n] and x given by its nonzeros (indices
+//  into the n columns); every row gathers the columns of the nonzeros, a
+//  CSR row product with the row of A as the dense operand
+//
+template <typename T>
+void
+gemv_sparse(size_t m, const T* a, size_t lda, size_t nonzeros, const uint32_t* indices, const T* values, T* y)
+{
+    const size_t offsets[2] = { 0, nonzeros };
+
+    parallel_for(0, m, grain::rows(nonzeros), [=](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            _spmv_serial(1, offsets, indices, values, a + i * lda, y + i);
+    });
+}
+
+//
+//  A += alpha * x * y^T for row-major A[m x n] and y given by its nonzeros;
+//  only the listed columns of A are written, scattered into every row
+//
+template <typename T>
+void
+ger_sparse_columns(size_t m, T alpha, const T* x, size_t nonzeros, const uint32_t* indices, const T* values, T* a, size_t lda)
+{
+    parallel_for(0, m, grain::rows(nonzeros), [=](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const T ax = alpha * x[i];
+            T* row = a + i * lda;
+
+            for (size_t k = 0; k < nonzeros; ++k)
+                row[indices[k]] += ax * values[k];
+        }
+    });
+}
+
+} // namespace kernel
+} // namespace blas
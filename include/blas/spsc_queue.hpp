@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace blas {
+
+//
+//  Bounded lock-free queue between one producer thread and one consumer
+//  thread, e.g. the stages of a pipeline
+//  The two ends sit on separate cache lines, and each end keeps a copy of
+//  the other's index, so it reads the other's line only when its copy says
+//  the queue is full or empty
+//
+template <typename T>
+class spsc_queue
+{
+    std::vector<T> _ring;
+    size_t _mask;
+
+    // consumer end
+    alignas(64) std::atomic<size_t> _head;
+    size_t _tail_seen;
+
+    // producer end
+    alignas(64) std::atomic<size_t> _tail;
+    size_t _head_seen;
+
+public:
+
+    //
+    //  capacity is rounded up to a power of two
+    //
+    explicit
+    spsc_queue(size_t capacity)
+    :   _head(0),
+        _tail_seen(0),
+        _tail(0),
+        _head_seen(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size *= 2;
+
+        _ring.resize(size);
+        _mask = size - 1;
+    }
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator = (const spsc_queue&) = delete;
+
+    size_t
+    capacity() const
+    {
+        return _ring.size();
+    }
+
+    //
+    //  Producer only; false when the queue is full
+    //
+    bool
+    push(const T& value)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+
+        if (tail - _head_seen == _ring.size())
+        {
+            _head_seen = _head.load(std::memory_order_acquire);
+            if (tail - _head_seen == _ring.size())
+                return false;
+        }
+
+        _ring[tail & _mask] = value;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //
+    //  Consumer only; whether a pop would fail right now
+    //
+    bool
+    empty() const
+    {
+        return _head.load(std::memory_order_relaxed) == _tail.load(std::memory_order_acquire);
+    }
+
+    //
+    //  Consumer only; false when the queue is empty
+    //
+    bool
+    pop(T& value)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+
+        if (head == _tail_seen)
+        {
+            _tail_seen = _tail.load(std::memory_order_acquire);
+            if (head == _tail_seen)
+                return false;
+        }
+
+        value = _ring[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+} // namespace blas
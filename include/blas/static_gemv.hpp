@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+
+#include "blas/dispatch.hpp"
+#include "blas/gemv.hpp"
+#include "blas/ger.hpp"
+
+namespace blas {
+namespace kernel {
+
+//
+//  Kernels of the fixed-shape containers: the extents are template
+//  parameters, so the dispatched bodies below are compiled with constant trip
+//  counts, unrolled and stripped of their tails
+//  They run on the calling thread and skip the CBLAS hook; a layer small
+//  enough to have a fixed shape costs less than waking the pool
+//
+
+//
+//  y = A^T * x for row-major A[M x N], see gemv_t_kernel
+//
+template <size_t M, size_t N>
+struct static_gemv_t_kernel
+{
+    template <typename T>
+    static inline __attribute__((always_inline))
+    void
+    run(const T* a, const T* x, T* y)
+    {
+        gemv_t_kernel::run(M, N, a, N, x, y);
+    }
+};
+
+//
+//  A += alpha * x * y^T for row-major A[M x N], see ger_kernel
+//
+template <size_t M, size_t N>
+struct static_ger_kernel
+{
+    template <typename T>
+    static inline __attribute__((always_inline))
+    void
+    run(T alpha, const T* x, const T* y, T* a)
+    {
+        ger_kernel::run(M, N, alpha, x, y, a, N);
+    }
+};
+
+//
+//  y = A * x for row-major A[M x N]
+//  The dot products keep the hand-written row kernels of gemv.hpp, whose
+//  register blocking the compiler does not reproduce from plain loops
+//
+template <size_t M, size_t N, typename T>
+void
+static_gemv(const T* a, const T* x, T* y)
+{
+    _gemv_serial(M, N, a, N, x, y);
+}
+
+template <size_t M, size_t N, typename T>
+void
+static_gemv_t(const T* a, const T* x, T* y)
+{
+    dispatch<static_gemv_t_kernel<M, N>>(a, x, y);
+}
+
+template <size_t M, size_t N, typename T>
+void
+static_ger(T alpha, const T* x, const T* y, T* a)
+{
+    dispatch<static_ger_kernel<M, N>>(alpha, x, y, a);
+}
+
+} // namespace kernel
+} // namespace blas
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+
+#include "blas/allocator.hpp"
+#include "blas/static_gemv.hpp"
+#include "blas/static_vector.hpp"
+#include "blas/view.hpp"
+
+namespace blas {
+
+//
+//  Row-major H x W matrix stored inside the object, for shapes known at
+//  compile time; never allocates
+//  Products take static_vectors of matching extents, so shape errors fail to
+//  compile, and run the fixed-shape kernels of static_gemv.hpp
+//
+template <typename T, size_t H, size_t W>
+struct static_matrix
+{
+public:
+
+    typedef T                   value_type;
+    typedef value_type*         pointer;
+    typedef const value_type*   const_pointer;
+    typedef value_type&         reference;
+    typedef const value_type&   const_reference;
+    typedef value_type*         iterator;
+    typedef const value_type*   const_iterator;
+    typedef unsigned            size_type;
+
+protected:
+
+    alignas(alignment) value_type _data[H * W];
+
+public:
+
+// Constructors ///////////////////////////////////////////////////////////
+
+    static_matrix()
+    :   _data()
+    {}
+
+    explicit
+    static_matrix(const_reference fillament)
+    {
+        fill(fillament);
+    }
+
+// Row getters ////////////////////////////////////////////////////////////
+
+    pointer
+    operator [] (size_type index)
+    {
+        return _data + index * W;
+    }
+
+    const_pointer
+    operator [] (size_type index) const
+    {
+        return _data + index * W;
+    }
+
+    void
+    fill(const_reference fillament)
+    {
+        for (size_t i = 0; i < H * W; ++i)
+            _data[i] = fillament;
+    }
+
+// Attributes getters /////////////////////////////////////////////////////
+
+    static constexpr
+    size_type
+    height()
+    {
+        return H;
+    }
+
+    static constexpr
+    size_type
+    width()
+    {
+        return W;
+    }
+
+    static constexpr
+    size_type
+    size()
+    {
+        return H * W;
+    }
+
+    pointer
+    data()
+    {
+        return _data;
+    }
+
+    const_pointer
+    data() const
+    {
+        return _data;
+    }
+
+    matrix_view<T>
+    view()
+    {
+        return matrix_view<T>(_data, H, W, W);
+    }
+
+    matrix_view<const T>
+    view() const
+    {
+        return matrix_view<const T>(_data, H, W, W);
+    }
+
+// Iterator methods ///////////////////////////////////////////////////////
+
+    iterator
+    begin()
+    {
+        return _data;
+    }
+
+    const_iterator
+    begin() const
+    {
+        return _data;
+    }
+
+    iterator
+    end()
+    {
+        return _data + H * W;
+    }
+
+    const_iterator
+    end() const
+    {
+        return _data + H * W;
+    }
+
+// Math ///////////////////////////////////////////////////////////////////
+
+    //
+    //  y = this * x
+    //
+    void
+    multiply(const static_vector<T, W>& x, static_vector<T, H>& y) const
+    {
+        kernel::static_gemv<H, W>(_data, x.data(), y.data());
+    }
+
+    //
+    //  y = this^T * x
+    //
+    void
+    multiply_transposed(const static_vector<T, H>& x, static_vector<T, W>& y) const
+    {
+        kernel::static_gemv_t<H, W>(_data, x.data(), y.data());
+    }
+
+    static_vector<T, H>
+    operator * (const static_vector<T, W>& x) const
+    {
+        static_vector<T, H> result;
+        multiply(x, result);
+        return result;
+    }
+
+    //
+    //  this += alpha * x * y^T
+    //
+    static_matrix&
+    rank1_update(const_reference alpha, const static_vector<T, H>& x, const static_vector<T, W>& y)
+    {
+        kernel::static_ger<H, W>(alpha, x.data(), y.data(), _data);
+        return *this;
+    }
+};
+
+} // namespace blas
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+#include "blas/allocator.hpp"
+#include "blas/view.hpp"
+
+namespace blas {
+
+//
+//  Vector of N elements stored inside the object, for shapes known at
+//  compile time; never allocates
+//
+template <typename T, size_t N>
+struct static_vector
+{
+public:
+
+    typedef T                   value_type;
+    typedef value_type*         pointer;
+    typedef const value_type*   const_pointer;
+    typedef value_type&         reference;
+    typedef const value_type&   const_reference;
+    typedef value_type*         iterator;
+    typedef const value_type*   const_iterator;
+    typedef unsigned            size_type;
+
+protected:
+
+    alignas(alignment) value_type _data[N];
+
+public:
+
+// Constructors ///////////////////////////////////////////////////////////
+
+    static_vector()
+    :   _data()
+    {}
+
+    explicit
+    static_vector(const_reference fillament)
+    {
+        fill(fillament);
+    }
+
+    //
+    //  Copy of a dynamic vector of the same size
+    //
+    template <typename _alloc>
+    explicit
+    static_vector(const vector<T, _alloc>& v)
+    {
+        assert(v.size() == N);
+        for (size_t i = 0; i < N; ++i)
+            _data[i] = v[i];
+    }
+
+// Element access /////////////////////////////////////////////////////////
+
+    reference
+    operator [] (size_type index)
+    {
+        return _data[index];
+    }
+
+    const_reference
+    operator [] (size_type index) const
+    {
+        return _data[index];
+    }
+
+    void
+    fill(const_reference fillament)
+    {
+        for (size_t i = 0; i < N; ++i)
+            _data[i] = fillament;
+    }
+
+// Attributes getters /////////////////////////////////////////////////////
+
+    static constexpr
+    size_type
+    size()
+    {
+        return N;
+    }
+
+    pointer
+    data()
+    {
+        return _data;
+    }
+
+    const_pointer
+    data() const
+    {
+        return _data;
+    }
+
+    vector_view<T>
+    view()
+    {
+        return vector_view<T>(_data, N);
+    }
+
+    vector_view<const T>
+    view() const
+    {
+        return vector_view<const T>(_data, N);
+    }
+
+// Iterator methods ///////////////////////////////////////////////////////
+
+    iterator
+    begin()
+    {
+        return _data;
+    }
+
+    const_iterator
+    begin() const
+    {
+        return _data;
+    }
+
+    iterator
+    end()
+    {
+        return _data + N;
+    }
+
+    const_iterator
+    end() const
+    {
+        return _data + N;
+    }
+};
+
+} // namespace blas
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace blas {
+
+//
+//  Minimum amount of work a parallel task gets; anything below runs inline
+//  on the calling thread without touching the pool
+//
+namespace grain {
+
+// elements per task for streaming element-wise loops
+constexpr size_t elementwise = 1 << 15;
+
+// multiply-adds per task for GEMV / GER style kernels
+constexpr size_t flops = 1 << 15;
+
+inline
+size_t
+rows(size_t columns)
+{
+    return columns >= flops ? 1 : flops / (columns ? columns : 1);
+}
+
+} // namespace grain
+
+//
+//  Persistent work-stealing thread pool behind every parallel BLAS loop
+//  parallel_for splits its range in halves down to the grain size; each half
+//  goes to the back of the current thread's queue, owners pop from the back
+//  and idle threads steal from the front of other queues, and the calling
+//  thread works on the range until all of it is done
+//  Loop bodies must not throw
+//
+class thread_pool
+{
+    struct job
+    {
+        void (*invoke)(const void*, size_t, size_t);
+        const void* body;
+        size_t grain;
+        std::atomic<size_t> remaining;
+    };
+
+    struct task
+    {
+        job* owner;
+        size_t begin, end;
+    };
+
+    //
+    //  Double-ended ring of tasks; it grows when full and never shrinks,
+    //  so loops that keep splitting the same ranges stop allocating
+    //
+    struct queue
+    {
+        std::mutex mutex;
+        std::vector<task> ring;
+        size_t head = 0, count = 0;
+
+        queue()
+        :   ring(64)
+        {}
+
+        bool
+        empty() const
+        {
+            return count == 0;
+        }
+
+        void
+        push_back(const task& t)
+        {
+            if (count == ring.size())
+            {
+                std::vector<task> grown(ring.size() * 2);
+                for (size_t i = 0; i < count; ++i)
+                    grown[i] = ring[(head + i) % ring.size()];
+
+                ring.swap(grown);
+                head = 0;
+            }
+
+            ring[(head + count) % ring.size()] = t;
+            ++count;
+        }
+
+        task
+        pop_back()
+        {
+            --count;
+            return ring[(head + count) % ring.size()];
+        }
+
+        task
+        pop_front()
+        {
+            const task t = ring[head];
+            head = (head + 1) % ring.size();
+            --count;
+            return t;
+        }
+    };
+
+    // queue 0 is shared by all threads outside the pool
+    std::vector<std::unique_ptr<queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    std::mutex _sleep_mutex;
+    std::condition_variable _wake;
+    std::atomic<size_t> _queued;
+    std::atomic<bool> _stop;
+
+    bool _pinned;
+
+    static inline thread_local size_t _index = 0;
+
+    thread_pool()
+    :   _queued(0),
+        _stop(false),
+        _pinned(false)
+    {
+        size_t threads = std::thread::hardware_concurrency();
+        if (const char* env = std::getenv("BLAS_NUM_THREADS"))
+            threads = std::strtoul(env, nullptr, 10);
+
+        _start(threads ? threads : 1);
+    }
+
+public:
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator = (const thread_pool&) = delete;
+
+    ~thread_pool()
+    {
+        _shutdown();
+    }
+
+    static
+    thread_pool&
+    instance()
+    {
+        static thread_pool pool;
+        return pool;
+    }
+
+// Configuration //////////////////////////////////////////////////////////
+
+    //
+    //  Number of threads working on a parallel loop, the caller included
+    //
+    size_t
+    size() const
+    {
+        return _workers.size() + 1;
+    }
+
+    //
+    //  Restarts the pool with the given number of threads;
+    //  must not be called while a parallel loop is running
+    //
+    void
+    resize(size_t threads)
+    {
+        if (threads == 0) threads = 1;
+        if (threads == size()) return;
+
+        _shutdown();
+        _start(threads);
+    }
+
+    //
+    //  Pins worker i to CPU i (modulo the CPU count), or lets them float again
+    //  The calling thread is left alone; returns false where unsupported
+    //
+    bool
+    pin(bool enable)
+    {
+        _pinned = enable;
+
+        bool ok = true;
+        for (size_t i = 0; i < _workers.size(); ++i)
+            ok = _set_affinity(_workers[i], i + 1) and ok;
+        return ok;
+    }
+
+// Execution //////////////////////////////////////////////////////////////
+
+    template <typename F>
+    void
+    parallel_for(size_t begin, size_t end, size_t grain, const F& body)
+    {
+        if (begin >= end) return;
+        if (grain == 0) grain = 1;
+
+        if (end - begin <= grain or _workers.empty())
+        {
+            body(begin, end);
+            return;
+        }
+
+        job j;
+        j.invoke = [](const void* f, size_t b, size_t e) { (*static_cast<const F*>(f))(b, e); };
+        j.body = &body;
+        j.grain = grain;
+        j.remaining.store(end - begin, std::memory_order_relaxed);
+
+        _execute({ &j, begin, end });
+
+        while (j.remaining.load(std::memory_order_acquire) != 0)
+            if (!_run_one())
+                std::this_thread::yield();
+    }
+
+private:
+
+    void
+    _start(size_t threads)
+    {
+        _stop = false;
+        _queues.clear();
+        for (size_t i = 0; i < threads; ++i)
+            _queues.emplace_back(new queue);
+
+        for (size_t i = 1; i < threads; ++i)
+            _workers.emplace_back([this, i] { _worker(i); });
+
+        if (_pinned) pin(true);
+    }
+
+    void
+    _shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+
+        for (auto& w : _workers)
+            w.join();
+        _workers.clear();
+    }
+
+    void
+    _worker(size_t index)
+    {
+        _index = index;
+
+        while (!_stop.load(std::memory_order_relaxed))
+        {
+            if (_run_one()) continue;
+
+            std::unique_lock<std::mutex> lock(_sleep_mutex);
+            _wake.wait(lock, [this] { return _stop.load() or _queued.load() != 0; });
+        }
+    }
+
+    void
+    _push(const task& t)
+    {
+        queue& q = *_queues[_index];
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.push_back(t);
+        }
+        _queued.fetch_add(1, std::memory_order_release);
+
+        // taking the sleep mutex orders this push against a worker about to wait
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+        }
+        _wake.notify_one();
+    }
+
+    void
+    _execute(task t)
+    {
+        const size_t grain = t.owner->grain;
+
+        while (t.end - t.begin > grain)
+        {
+            const size_t middle = t.begin + (t.end - t.begin) / 2;
+            _push({ t.owner, middle, t.end });
+            t.end = middle;
+        }
+
+        t.owner->invoke(t.owner->body, t.begin, t.end);
+        t.owner->remaining.fetch_sub(t.end - t.begin, std::memory_order_acq_rel);
+    }
+
+    bool
+    _run_one()
+    {
+        if (_queued.load(std::memory_order_acquire) == 0) return false;
+
+        task t;
+        bool found = false;
+
+        // own queue: newest first, it is the hottest in cache
+        {
+            queue& q = *_queues[_index];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.empty())
+            {
+                t = q.pop_back();
+                found = true;
+            }
+        }
+
+        // steal the oldest, largest task from someone else
+        for (size_t k = 1; !found and k < _queues.size(); ++k)
+        {
+            queue& q = *_queues[(_index + k) % _queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.empty())
+            {
+                t = q.pop_front();
+                found = true;
+            }
+        }
+
+        if (!found) return false;
+
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        _execute(t);
+        return true;
+    }
+
+    bool
+    _set_affinity(std::thread& thread, size_t cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        if (_pinned)
+        {
+            const size_t cpus = std::thread::hardware_concurrency();
+            CPU_SET(cpu % (cpus ? cpus : 1), &set);
+        } else {
+            for (int i = 0; i < CPU_SETSIZE; ++i)
+                CPU_SET(i, &set);
+        }
+
+        return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+        (void)thread;
+        (void)cpu;
+        return false;
+#endif
+    }
+};
+
+//
+//  While alive, every parallel loop started on the current thread runs inline
+//  For threads that are already one of several workers of their own, such
+//  as those of neural::parallel_trainer, so they do not all queue on the pool
+//  With enable = false it changes nothing, for a single such worker
+//
+class serial_region
+{
+    bool _previous;
+
+public:
+
+    explicit
+    serial_region(bool enable = true)
+    :   _previous(active())
+    {
+        _active() = _previous or enable;
+    }
+
+    serial_region(const serial_region&) = delete;
+    serial_region& operator = (const serial_region&) = delete;
+
+    ~serial_region()
+    {
+        _active() = _previous;
+    }
+
+    static
+    bool
+    active()
+    {
+        return _active();
+    }
+
+private:
+
+    static
+    bool&
+    _active()
+    {
+        static thread_local bool active = false;
+        return active;
+    }
+};
+
+// Free functions /////////////////////////////////////////////////////////
+
+template <typename F>
+void
+parallel_for(size_t begin, size_t end, size_t grain, const F& body)
+{
+    if (end - begin <= grain or serial_region::active())
+        body(begin, end);
+    else
+        thread_pool::instance().parallel_for(begin, end, grain, body);
+}
+
+inline
+size_t
+num_threads()
+{
+    return thread_pool::instance().size();
+}
+
+inline
+void
+set_num_threads(size_t threads)
+{
+    thread_pool::instance().resize(threads);
+}
+
+inline
+bool
+set_thread_affinity(bool pinned)
+{
+    return thread_pool::instance().pin(pinned);
+}
+
+} // namespace blas
@@ -1,8 +1,17 @@
 #pragma once
 
 #include <iostream>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
 
 #include "blas/allocator.hpp"
+#include "blas/copy.hpp"
+#include "blas/thread_pool.hpp"
+#include "blas/expression.hpp"
+#include "blas/ger.hpp"
+#include "blas/view.hpp"
 #include "blas/matrix.hpp"
 
 namespace blas {
@@ -10,8 +19,43 @@ namespace blas {
 template <typename T, typename _alloc>
 struct matrix;
 
-template <typename T, typename _alloc = allocator<T>>
-struct vector
+//
+//  Inline element storage of a vector, empty unless the allocator
+//  is a small_allocator
+//
+template <typename T, size_t N>
+struct small_buffer
+{
+    static_assert(std::is_trivial<T>::value, "small_buffer: inline storage holds trivial types only");
+
+    alignas(alignment) T _buffer[N];
+
+    T*
+    _inline_data()
+    {
+        return _buffer;
+    }
+
+    const T*
+    _inline_data() const
+    {
+        return _buffer;
+    }
+};
+
+template <typename T>
+struct small_buffer<T, 0>
+{
+    T*
+    _inline_data() const
+    {
+        return nullptr;
+    }
+};
+
+template <typename T, typename _alloc = pool_allocator<T>>
+struct vector : vector_expression<vector<T, _alloc>>,
+                small_buffer<T, inline_capacity<_alloc>::value>
 {
 public:
 
@@ -169,6 +213,7 @@ public:
         _capacity(0)
     {}
 
+    explicit
     vector(size_type size) 
     :   _size(size),
         _capacity(size)
@@ -181,10 +226,7 @@ public:
         _capacity(m._size)
     {
         _data = _allocate(_capacity);
-
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] = m._data[i];
+        kernel::copy(size(), m._data, _data);
     }
 
     vector(vector&& m) 
@@ -192,7 +234,25 @@ public:
         _size(m._size),
         _capacity(m._capacity)
     {
-        m._data = nullptr;
+        if (m._is_inline())
+        {
+            // inline elements can not be stolen, only copied
+            _data = _allocate(_capacity);
+            kernel::copy(_size, m._data, _data);
+        } else {
+            m._data = nullptr;
+            m._capacity = 0;
+        }
+        m._size = 0;
+    }
+
+    template <typename E>
+    vector(const vector_expression<E>& e)
+    :   _size(e.self().size()),
+        _capacity(e.self().size())
+    {
+        _data = _allocate(_capacity);
+        _assign(e.self());
     }
     
     template <typename _T>
@@ -202,16 +262,18 @@ public:
     {
         _data = _allocate(_capacity);
 
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] = f(m[i]);
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] = f(m[i]);
+        });
     }
     
 // Destructor /////////////////////////////////////////////////////////////
 
     ~vector()
     {
-        _deallocate(_data);
+        _deallocate(_data, _capacity);
     }
 
 // Assignment operators ///////////////////////////////////////////////////
@@ -222,10 +284,7 @@ public:
         if (&m != this)
         {
             resize(m._size);
-
-            #pragma omp parallel for
-            for (size_type i = 0; i < size(); ++i)
-                _data[i] = m._data[i];
+            kernel::copy(size(), m._data, _data);
         }
         return *this;
     }
@@ -233,14 +292,31 @@ public:
     vector& 
     operator = (vector&& m)
     {
-        if (&m != this)
+        if (&m == this) return *this;
+
+        if (m._is_inline())
         {
-            _deallocate(_data);
+            *this = static_cast<const vector&>(m);
+        } else {
+            _deallocate(_data, _capacity);
             _size = m._size;
             _capacity = m._capacity;
             _data = m._data;
             m._data = nullptr;
+            m._capacity = 0;
         }
+        m._size = 0;
+        return *this;
+    }
+
+    template <typename E>
+    vector&
+    operator = (const vector_expression<E>& e)
+    {
+        // element i of the expression only reads element i of its operands,
+        // so evaluating into a vector the expression refers to is safe
+        resize(e.self().size());
+        _assign(e.self());
         return *this;
     }
 
@@ -253,19 +329,25 @@ public:
         {
             _size = size;
         } else {
-            _deallocate(_data);
+            _deallocate(_data, _capacity);
             _size = size;
             _capacity = size;
             _data = _allocate(_capacity);
         }
     }
 
+    void
+    fill(const_reference value)
+    {
+        kernel::fill(size(), value, _data);
+    }
+
     void
     reserve(size_type size)
     {
         if (size > _capacity)
         {
-            _deallocate(_data);
+            _deallocate(_data, _capacity);
             _capacity = size;
             _data = _allocate(_capacity);
         }
@@ -345,6 +427,18 @@ public:
         return _data;
     }
 
+    vector_view<T>
+    view()
+    {
+        return vector_view<T>(_data, _size);
+    }
+
+    vector_view<const T>
+    view() const
+    {
+        return vector_view<const T>(_data, _size);
+    }
+
 // Comparson //////////////////////////////////////////////////////////////
 
     void
@@ -352,6 +446,7 @@ public:
     {
         if (_size == _capacity)
         {
+            const size_type old_capacity = _capacity;
             if (_capacity == 0)
                 _capacity = 1;
             else
@@ -359,11 +454,10 @@ public:
                 
             pointer _temp = _allocate(_capacity);
             
-            #pragma omp parallel for
             for (size_type i = 0; i < _size; ++i)
                 _temp[i] = _data[i];
 
-            _deallocate(_data);
+            _deallocate(_data, old_capacity);
             _data = _temp;
         }
 
@@ -375,16 +469,16 @@ public:
     {
         if (_size == _capacity)
         {
+            const size_type old_capacity = _capacity;
             if (_capacity == 0) _capacity = 1;
 
             _capacity *= 2;
             pointer _temp = _allocate(_capacity);
             
-            #pragma omp parallel for
             for (size_type i = 0; i < _size; ++i)
                 _temp[i] = _data[i];
 
-            _deallocate(_data);
+            _deallocate(_data, old_capacity);
             _data = _temp;
         }
 
@@ -400,7 +494,7 @@ public:
     void
     erase()
     {
-        _deallocate(_data);
+        _deallocate(_data, _capacity);
         _size = 0;
         _capacity = 0;
         _data = nullptr;
@@ -499,122 +593,76 @@ public:
         return !((*this) == m);
     }
 
-// Binary operators ///////////////////////////////////////////////////////
-
-    vector
-    operator + (const vector& m) const
-    {
-        vector result(*this);
-        result += m;
-        return result;
-    }
-
-    vector
-    operator - (const vector& m) const
-    {
-        vector result(*this);
-        result -= m;
-        return result;
-    }
-
-    vector
-    operator * (const vector& m) const
-    {
-        vector result(*this);
-        result *= m;
-        return result;
-    }
-
-    vector
-    operator / (const vector& m) const
-    {
-        vector result(*this);
-        result /= m;
-        return result;
-    }
-
-    vector
-    operator + (const_reference value) const
-    {
-        vector result(*this);
-        result += value;
-        return result;
-    }
-
-    vector
-    operator - (const_reference value) const
-    {
-        vector result(*this);
-        result -= value;
-        return result;
-    }
-
-    vector
-    operator * (const_reference value) const
-    {
-        vector result(*this);
-        result *= value;
-        return result;
-    }
-
-    vector
-    operator / (const_reference value) const
-    {
-        vector result(*this);
-        result /= value;
-        return result;
-    }
-
 // Binary mutating operators //////////////////////////////////////////////
+//
+//  Binary and unary arithmetic is provided by the lazy operators in
+//  blas/expression.hpp; these evaluate the right hand side in place
+//
 
+    template <typename E>
     vector&
-    operator += (const vector& m)
+    operator += (const vector_expression<E>& e)
     {
-        if (_size != m._size)
+        const E& m = e.self();
+        if (_size != m.size())
             throw std::invalid_argument("vector::operator += : size mismatch");
 
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] += m._data[i];
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] += m[i];
+        });
 
         return *this;
     }
 
+    template <typename E>
     vector&
-    operator -= (const vector& m)
+    operator -= (const vector_expression<E>& e)
     {
-        if (_size != m._size)
+        const E& m = e.self();
+        if (_size != m.size())
             throw std::invalid_argument("vector::operator -= : size mismatch");
 
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] -= m._data[i];
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] -= m[i];
+        });
 
         return *this;
     }
 
+    template <typename E>
     vector&
-    operator *= (const vector& m)
+    operator *= (const vector_expression<E>& e)
     {
-        if (_size != m._size)
+        const E& m = e.self();
+        if (_size != m.size())
             throw std::invalid_argument("vector::operator *= : size mismatch");
 
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] *= m._data[i];
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] *= m[i];
+        });
 
         return *this;
     }
 
+    template <typename E>
     vector&
-    operator /= (const vector& m)
+    operator /= (const vector_expression<E>& e)
     {
-        if (_size != m._size)
+        const E& m = e.self();
+        if (_size != m.size())
             throw std::invalid_argument("vector::operator /= : size mismatch");
 
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] /= m._data[i];
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] /= m[i];
+        });
 
         return *this;
     }
@@ -622,9 +670,11 @@ public:
     vector&
     operator += (const_reference value)
     {
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] += value;
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] += value;
+        });
 
         return *this;
     }
@@ -632,19 +682,23 @@ public:
     vector&
     operator -= (const_reference value)
     {
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] -= value;
-            
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] -= value;
+        });
+
         return *this;
     }
 
     vector&
     operator *= (const_reference value)
     {
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] *= value;
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] *= value;
+        });
 
         return *this;
     }
@@ -652,58 +706,31 @@ public:
     vector&
     operator /= (const_reference value)
     {
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            _data[i] /= value;
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] /= value;
+        });
 
         return *this;
     }
 
-// Unary operators /////////////////////////////////////////////////////////
+// Math ///////////////////////////////////////////////////////////////////
 
-    vector
-    operator - () const
+    //
+    //  this += alpha * x, in place
+    //
+    template <typename _xalloc>
+    vector&
+    axpy(const_reference alpha, const vector<T, _xalloc>& x)
     {
-        vector result(*this);
-
-        #pragma omp parallel for
-        for (size_type i = 0; i < size(); ++i)
-            result._data[i] = -result._data[i];
-
-        return result;
-    }
+        if (_size != x.size())
+            throw std::invalid_argument("vector::axpy : size mismatch");
 
-    vector
-    operator + () const
-    {
+        kernel::axpy<value_type>(_size, alpha, x.data(), _data);
         return *this;
     }
 
-// Frien operators /////////////////////////////////////////////////////////
-
-    friend
-    vector
-    operator + (const_reference value, const vector& v)
-    {
-        return v + value;
-    }
-
-    friend
-    vector
-    operator - (const_reference value, const vector& v)
-    {
-        return v - value;
-    }
-
-    friend
-    vector
-    operator * (const_reference value, const vector& v)
-    {
-        return v * value;
-    }
-
-// Math ///////////////////////////////////////////////////////////////////
-
     static 
     T
     inner_product(const vector& a, const vector& b)
@@ -713,7 +740,6 @@ public:
 
         T result = 0;
 
-        #pragma omp parallel for reduction(+:result)
         for (size_t i = 0; i < a.size(); ++i)
             result += a[i] * b[i];
 
@@ -726,15 +752,12 @@ public:
     {
         matrix<T> result(a.size(), b.size());
 
-        #pragma omp parallel for
-        for (size_t i = 0; i < a.size(); ++i)
+        parallel_for(0, a.size(), grain::rows(b.size()), [&](size_t begin, size_t end)
         {
-            #pragma omp parallel for
-            for (size_t j = 0; j < b.size(); ++j)
-            {
-                result[i][j] = a[i] * b[j];
-            }
-        }
+            for (size_t i = begin; i < end; ++i)
+                for (size_t j = 0; j < b.size(); ++j)
+                    result[i][j] = a[i] * b[j];
+        });
         
         return result;
     }
@@ -757,17 +780,53 @@ public:
 
 private:
 
-    static
+    template <typename E>
+    void
+    _assign(const E& e)
+    {
+        parallel_for(0, size(), grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i] = e[i];
+        });
+    }
+
+    //
+    //  Every slot up to the capacity holds a live object; element types
+    //  with non-trivial constructors or destructors (vectors of vectors,
+    //  layers) are constructed and destroyed here, recycled memory from the
+    //  allocator is never assigned to as if it were an object
+    //
+    bool
+    _is_inline() const
+    {
+        return inline_capacity<_alloc>::value and _data == this->_inline_data();
+    }
+
     pointer
     _allocate(size_type size)
     {
-        return _alloc::allocate(size);
+        if (size and size <= inline_capacity<_alloc>::value)
+            return this->_inline_data();
+
+        pointer ptr = _alloc::allocate(size);
+
+        if (!std::is_trivially_default_constructible<T>::value)
+            for (size_type i = 0; i < size; ++i)
+                new (ptr + i) T();
+
+        return ptr;
     }
 
-    static
     void
-    _deallocate(pointer ptr)
+    _deallocate(pointer ptr, size_type size)
     {
+        if (!ptr or ptr == this->_inline_data()) return;
+
+        if (!std::is_trivially_destructible<T>::value)
+            for (size_type i = 0; i < size; ++i)
+                ptr[i].~T();
+
         _alloc::deallocate(ptr);
     }
 
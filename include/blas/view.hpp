@@ -0,0 +1,434 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#include "blas/expression.hpp"
+#include "blas/gemm.hpp"
+#include "blas/gemv.hpp"
+#include "blas/ger.hpp"
+#include "blas/thread_pool.hpp"
+
+namespace blas {
+
+template <typename T, typename _alloc>
+struct vector;
+
+template <typename T, typename _alloc>
+struct matrix;
+
+//
+//  Non-owning views: a pointer, a shape and strides into memory owned by
+//  something else, which must outlive the view
+//  T is const for read-only views; a mutable view converts to a const one
+//  Copying a view copies the reference, assign() writes the elements
+//
+
+// Vector view ////////////////////////////////////////////////////////////
+
+template <typename T>
+struct vector_view : vector_expression<vector_view<T>>
+{
+public:
+
+    typedef typename std::remove_const<T>::type value_type;
+    typedef T*                                  pointer;
+    typedef T&                                  reference;
+    typedef unsigned                            size_type;
+
+protected:
+
+    pointer _data;
+    size_type _size;
+    size_t _stride;
+
+public:
+
+// Constructors ///////////////////////////////////////////////////////////
+
+    vector_view()
+    :   _data(nullptr),
+        _size(0),
+        _stride(1)
+    {}
+
+    vector_view(pointer data, size_type size, size_t stride = 1)
+    :   _data(data),
+        _size(size),
+        _stride(stride)
+    {}
+
+    template <typename _alloc>
+    vector_view(vector<value_type, _alloc>& v)
+    :   vector_view(v.data(), v.size())
+    {}
+
+    template <typename _alloc, typename U = T, typename = std::enable_if_t<std::is_const<U>::value>>
+    vector_view(const vector<value_type, _alloc>& v)
+    :   vector_view(v.data(), v.size())
+    {}
+
+    template <typename U, typename = std::enable_if_t<std::is_same<const U, T>::value>>
+    vector_view(const vector_view<U>& v)
+    :   vector_view(v.data(), v.size(), v.stride())
+    {}
+
+// Element access /////////////////////////////////////////////////////////
+
+    reference
+    operator [] (size_type index) const
+    {
+        return _data[index * _stride];
+    }
+
+    //
+    //  Evaluates an expression of the same size into the viewed elements
+    //
+    template <typename E>
+    const vector_view&
+    assign(const vector_expression<E>& e) const
+    {
+        const E& expr = e.self();
+        assert(expr.size() == _size);
+
+        parallel_for(0, _size, grain::elementwise, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                _data[i * _stride] = expr[i];
+        });
+        return *this;
+    }
+
+// Slicing ////////////////////////////////////////////////////////////////
+
+    vector_view
+    slice(size_type begin, size_type size) const
+    {
+        assert(begin + size <= _size);
+        return vector_view(_data + begin * _stride, size, _stride);
+    }
+
+// Attributes getters /////////////////////////////////////////////////////
+
+    size_type
+    size() const
+    {
+        return _size;
+    }
+
+    size_t
+    stride() const
+    {
+        return _stride;
+    }
+
+    pointer
+    data() const
+    {
+        return _data;
+    }
+
+    bool
+    contiguous() const
+    {
+        return _stride == 1;
+    }
+};
+
+//
+//  Views are as cheap as a pointer, expressions hold them by value
+//  so a temporary row or slice may appear inside an expression
+//
+template <typename T>
+struct operand<vector_view<T>>
+{
+    typedef vector_view<T> type;
+};
+
+// Matrix view ////////////////////////////////////////////////////////////
+
+//
+//  Element (i, j) is data[i * row_stride + j * column_stride], so a row-major
+//  block has column stride 1 and its transpose just swaps the strides
+//
+template <typename T>
+struct matrix_view
+{
+public:
+
+    typedef typename std::remove_const<T>::type value_type;
+    typedef T*                                  pointer;
+    typedef T&                                  reference;
+    typedef unsigned                            size_type;
+
+protected:
+
+    pointer _data;
+    size_type _height, _width;
+    size_t _row_stride, _column_stride;
+
+public:
+
+// Constructors ///////////////////////////////////////////////////////////
+
+    matrix_view()
+    :   _data(nullptr),
+        _height(0),
+        _width(0),
+        _row_stride(0),
+        _column_stride(1)
+    {}
+
+    matrix_view(pointer data, size_type height, size_type width, size_t row_stride, size_t column_stride = 1)
+    :   _data(data),
+        _height(height),
+        _width(width),
+        _row_stride(row_stride),
+        _column_stride(column_stride)
+    {}
+
+    template <typename _alloc>
+    matrix_view(matrix<value_type, _alloc>& m)
+    :   matrix_view(m.data(), m.height(), m.width(), m.width())
+    {}
+
+    template <typename _alloc, typename U = T, typename = std::enable_if_t<std::is_const<U>::value>>
+    matrix_view(const matrix<value_type, _alloc>& m)
+    :   matrix_view(m.data(), m.height(), m.width(), m.width())
+    {}
+
+    template <typename U, typename = std::enable_if_t<std::is_same<const U, T>::value>>
+    matrix_view(const matrix_view<U>& m)
+    :   matrix_view(m.data(), m.height(), m.width(), m.row_stride(), m.column_stride())
+    {}
+
+// Element access /////////////////////////////////////////////////////////
+
+    reference
+    operator () (size_type row, size_type column) const
+    {
+        return _data[row * _row_stride + column * _column_stride];
+    }
+
+// Slicing ////////////////////////////////////////////////////////////////
+
+    vector_view<T>
+    row(size_type index) const
+    {
+        return vector_view<T>(_data + index * _row_stride, _width, _column_stride);
+    }
+
+    vector_view<T>
+    column(size_type index) const
+    {
+        return vector_view<T>(_data + index * _column_stride, _height, _row_stride);
+    }
+
+    //
+    //  Rows [begin, begin + count), e.g. a batch of samples stored one per row
+    //
+    matrix_view
+    rows(size_type begin, size_type count) const
+    {
+        assert(begin + count <= _height);
+        return matrix_view(_data + begin * _row_stride, count, _width, _row_stride, _column_stride);
+    }
+
+    matrix_view
+    block(size_type row, size_type column, size_type height, size_type width) const
+    {
+        assert(row + height <= _height and column + width <= _width);
+        return matrix_view(_data + row * _row_stride + column * _column_stride, height, width, _row_stride, _column_stride);
+    }
+
+    matrix_view
+    transposed() const
+    {
+        return matrix_view(_data, _width, _height, _column_stride, _row_stride);
+    }
+
+// Attributes getters /////////////////////////////////////////////////////
+
+    size_type
+    height() const
+    {
+        return _height;
+    }
+
+    size_type
+    width() const
+    {
+        return _width;
+    }
+
+    size_type
+    size() const
+    {
+        return _height * _width;
+    }
+
+    size_t
+    row_stride() const
+    {
+        return _row_stride;
+    }
+
+    size_t
+    column_stride() const
+    {
+        return _column_stride;
+    }
+
+    pointer
+    data() const
+    {
+        return _data;
+    }
+};
+
+// Kernels on views ///////////////////////////////////////////////////////
+
+//
+//  Operands are taken as const views in a non-deduced context, so matrices,
+//  vectors and mutable views convert implicitly; T comes from the output
+//  Strided vectors are gathered into a thread local buffer (O(n), never the
+//  matrix) when a kernel needs them contiguous
+//
+
+template <typename T>
+struct _view_operand
+{
+    typedef T type;
+};
+
+template <typename T>
+const T*
+_contiguous(const vector_view<const T>& v, kernel::gemm_buffer<T>& buffer)
+{
+    if (v.contiguous()) return v.data();
+
+    T* data = buffer.get(v.size());
+    for (size_t i = 0; i < v.size(); ++i)
+        data[i] = v[i];
+    return data;
+}
+
+//
+//  y = A * x
+//
+template <typename T>
+void
+gemv(
+    typename _view_operand<matrix_view<const T>>::type a,
+    typename _view_operand<vector_view<const T>>::type x,
+    const vector_view<T>& y
+)
+{
+    assert(a.width() == x.size() and a.height() == y.size());
+
+    static thread_local kernel::gemm_buffer<T> x_buffer, y_buffer;
+
+    if (a.column_stride() != 1 and a.row_stride() != 1)
+    {
+        for (size_t i = 0; i < a.height(); ++i)
+        {
+            T sum = T(0);
+            for (size_t j = 0; j < a.width(); ++j)
+                sum += a(i, j) * x[j];
+            y[i] = sum;
+        }
+        return;
+    }
+
+    const T* xp = _contiguous(x, x_buffer);
+    T* yp = y.contiguous() ? y.data() : y_buffer.get(y.size());
+
+    if (a.column_stride() == 1)
+        kernel::gemv<T>(a.height(), a.width(), a.data(), a.row_stride(), xp, yp);
+    else
+        // a transposed row-major block
+        kernel::gemv_t<T>(a.width(), a.height(), a.data(), a.column_stride(), xp, yp);
+
+    if (!y.contiguous())
+        for (size_t i = 0; i < y.size(); ++i)
+            y[i] = yp[i];
+}
+
+//
+//  C = A * B + beta * C; A and B may have any strides,
+//  C must have unit column stride
+//
+template <typename T>
+void
+gemm(
+    typename _view_operand<matrix_view<const T>>::type a,
+    typename _view_operand<matrix_view<const T>>::type b,
+    const matrix_view<T>& c,
+    T beta = T(0)
+)
+{
+    assert(a.width() == b.height() and c.height() == a.height() and c.width() == b.width());
+    assert(c.column_stride() == 1);
+
+    kernel::gemm<T>(
+        c.height(), c.width(), a.width(),
+        a.data(), a.row_stride(), a.column_stride(),
+        b.data(), b.row_stride(), b.column_stride(),
+        beta, c.data(), c.row_stride()
+    );
+}
+
+//
+//  A += alpha * x * y^T
+//
+template <typename T>
+void
+ger(
+    typename _view_operand<T>::type alpha,
+    typename _view_operand<vector_view<const T>>::type x,
+    typename _view_operand<vector_view<const T>>::type y,
+    const matrix_view<T>& a
+)
+{
+    assert(a.height() == x.size() and a.width() == y.size());
+
+    static thread_local kernel::gemm_buffer<T> x_buffer, y_buffer;
+
+    if (a.column_stride() == 1)
+    {
+        kernel::ger<T>(a.height(), a.width(), alpha, _contiguous(x, x_buffer), _contiguous(y, y_buffer), a.data(), a.row_stride());
+    } else if (a.row_stride() == 1) {
+        // the transpose is row-major: A^T += alpha * y * x^T
+        kernel::ger<T>(a.width(), a.height(), alpha, _contiguous(y, y_buffer), _contiguous(x, x_buffer), a.data(), a.column_stride());
+    } else {
+        for (size_t i = 0; i < a.height(); ++i)
+            for (size_t j = 0; j < a.width(); ++j)
+                a(i, j) += alpha * x[i] * y[j];
+    }
+}
+
+//
+//  y += alpha * x
+//
+template <typename T>
+void
+axpy(
+    typename _view_operand<T>::type alpha,
+    typename _view_operand<vector_view<const T>>::type x,
+    const vector_view<T>& y
+)
+{
+    assert(x.size() == y.size());
+
+    if (y.contiguous())
+    {
+        static thread_local kernel::gemm_buffer<T> x_buffer;
+        kernel::axpy<T>(y.size(), alpha, _contiguous(x, x_buffer), y.data());
+    } else {
+        for (size_t i = 0; i < y.size(); ++i)
+            y[i] += alpha * x[i];
+    }
+}
+
+} // namespace blas
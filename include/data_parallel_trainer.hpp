@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+
+#include "blas/vector.hpp"
+#include "blas/view.hpp"
+#include "blas/ger.hpp"
+#include "blas/thread_pool.hpp"
+
+#include "network.hpp"
+
+namespace neural
+{
+
+//
+//  Synchronous data-parallel mini-batch SGD, the deterministic counterpart
+//  of parallel_trainer
+//  A mini-batch is cut into a fixed number of slices; every slice runs the
+//  batch passes of network on its rows and sums their updates into a private
+//  gradient with one matrix product per layer, the gradients are merged
+//  by a pairwise tree and the network takes one step by their mean
+//  Slices map to buffers by index, not by the thread that runs them, and the
+//  tree adds in a fixed order, so for a given slice count the weights are
+//  bit-identical from run to run whatever the scheduling; the slices and
+//  every level of the tree are spread over the BLAS thread pool
+//
+template <typename T = double>
+class data_parallel_trainer
+{
+public:
+
+    typedef T           value_type;
+    typedef network<T>  network_type;
+
+    // elements each reduction task adds, small enough to stay in L1
+    static constexpr size_t chunk = 4096 / sizeof(T);
+
+private:
+
+    // buffers of neighbouring slices must not share cache lines
+    struct alignas(64) slot
+    {
+        typename network_type::batch_workspace work;
+        typename network_type::gradient gradient;
+    };
+
+    network_type& _network;
+    blas::vector<slot> _slots;
+
+public:
+
+    //
+    //  slices = 0 takes one per thread of the pool
+    //
+    explicit
+    data_parallel_trainer(network_type& net, size_t slices = 0)
+    :   _network(net)
+    {
+        if (slices == 0) slices = blas::num_threads();
+
+        _slots.resize(slices);
+        for (auto& s : _slots)
+        {
+            s.work = _network.make_batch_workspace();
+            s.gradient = _network.make_gradient();
+        }
+    }
+
+    size_t
+    slices() const
+    {
+        return _slots.size();
+    }
+
+    //
+    //  One step on a mini-batch of samples and targets stored one per row,
+    //  by the mean update of the batch, as network::train_batch
+    //
+    void
+    train_batch(const blas::matrix_view<const T>& inputs, const blas::matrix_view<const T>& targets, T learning_rate)
+    {
+        assert(inputs.height() == targets.height());
+
+        const size_t batch = inputs.height();
+        if (batch == 0) return;
+
+        // gradient of every slice into its own buffers
+        const size_t slices = _slots.size();
+        blas::parallel_for(0, slices, 1, [&](size_t begin, size_t end)
+        {
+            blas::serial_region serial;
+
+            for (size_t t = begin; t < end; ++t)
+            {
+                const size_t first = batch * t / slices;
+                const size_t count = batch * (t + 1) / slices - first;
+
+                slot& s = _slots[t];
+                s.gradient.clear();
+
+                if (count > 0)
+                    _network.accumulate_batch(inputs.rows(first, count), targets.rows(first, count), s.gradient, s.work);
+            }
+        });
+
+        // tree: at distance stride, slot t takes in slot t + stride
+        for (size_t stride = 1; stride < slices; stride *= 2)
+        {
+            for (size_t l = 0; l < _network.layers().size(); ++l)
+            {
+                _merge(stride, [l](slot& s) { return &s.gradient.layers[l].weights; });
+                _merge(stride, [l](slot& s) { return &s.gradient.layers[l].bias; });
+            }
+        }
+
+        _network.apply(_slots[0].gradient, learning_rate / T(batch));
+    }
+
+private:
+
+    //
+    //  One level of the tree for one buffer, as pairs x chunks tasks
+    //
+    template <typename F>
+    void
+    _merge(size_t stride, F buffer)
+    {
+        const size_t slices = _slots.size();
+        const size_t pairs = (slices - stride + 2 * stride - 1) / (2 * stride);
+        const size_t n = buffer(_slots[0])->size();
+        const size_t chunks = (n + chunk - 1) / chunk;
+
+        blas::parallel_for(0, pairs * chunks, 1, [&](size_t begin, size_t end)
+        {
+            blas::serial_region serial;
+
+            for (size_t k = begin; k < end; ++k)
+            {
+                const size_t t = k / chunks * 2 * stride;
+                const size_t offset = k % chunks * chunk;
+
+                blas::kernel::axpy<T>(
+                    std::min(chunk, n - offset), T(1),
+                    buffer(_slots[t + stride])->data() + offset,
+                    buffer(_slots[t])->data() + offset
+                );
+            }
+        });
+    }
+};
+
+} // namespace neural
@@ -1,45 +1,159 @@
 #pragma once
 
+#include <cassert>
 #include <random>
 
 #include "blas/vector.hpp"
 #include "blas/matrix.hpp"
+#include "blas/sparse_vector.hpp"
+#include "blas/activation.hpp"
+#include "blas/relaxed.hpp"
 
 namespace neural
 {
 
+template <typename T>
+T
+sigmoid(T x)
+{
+    return T(1) / (T(1) + std::exp(-x));
+}
+
+//
+//  float and double take the branch-free approximations, see blas/activation.hpp
+//
+inline
+float
+sigmoid(float x)
+{
+    return blas::fast::sigmoid(x);
+}
+
+inline
 double
 sigmoid(double x)
 {
-    return 1.0 / (1.0 + std::exp(-x));
+    return blas::fast::sigmoid(x);
 }
 
-double
-sigmid_derivative(double x)
+template <typename T>
+T
+sigmid_derivative(T x)
 {
-    return x * (1.0 - x);
+    return x * (T(1) - x);
 }
 
-double
-tanh(double x)
+template <typename T>
+T
+tanh(T x)
 {
     return std::tanh(x);
 }
 
+inline
+float
+tanh(float x)
+{
+    return blas::fast::tanh(x);
+}
+
+inline
 double
-tanh_derivative(double x)
+tanh(double x)
+{
+    return blas::fast::tanh(x);
+}
+
+template <typename T>
+T
+tanh_derivative(T x)
 {
-    return 1.0 - x * x;
+    return T(1) - x * x;
 }
-    
+
+//
+//  Fully connected tanh layer
+//  Weights are kept one row per output, or, for a layer fed
+//  blas::sparse_vectors, one row per input, so that the nonzeros of the input
+//  select whole contiguous rows in both the product and the update; the
+//  order is fixed when the layer is built and every input works with both
+//
+template <typename T = double>
 class layer
 {
 public:
 
-    layer(size_t in_size, size_t out_size)
-    :   _neurons(out_size),
-        _weights(out_size, in_size),
-        _bias(out_size)
+    typedef T value_type;
+
+    // activations and errors of typical layer widths stay inside the layer
+    typedef blas::vector<T, blas::small_allocator<T, 64>> vector_type;
+
+    // wide layers put their weights on huge pages, see blas::huge_pages
+    typedef blas::matrix<T, blas::huge_page_allocator<T>> weights_type;
+
+    //
+    //  Storage order of the weights
+    //
+    enum order
+    {
+        output_major,   // one row per output, suits dense inputs
+        input_major     // one row per input, suits sparse inputs
+    };
+
+    //
+    //  Buffers of one forward and backward pass over a shared layer
+    //  The layer keeps one for its own passes; threads training the same
+    //  weights bring one each, see parallel_trainer
+    //
+    struct workspace
+    {
+        vector_type neurons;
+        vector_type delta;
+        vector_type gradient;
+
+        workspace(size_t in_size = 0, size_t out_size = 0)
+        :   neurons(out_size),
+            delta(in_size),
+            gradient(out_size)
+        {}
+    };
+
+    //
+    //  Sum of the weight and bias updates of several samples, kept in the
+    //  storage order of the weights; filled by accumulate_batch, applied by apply
+    //
+    struct gradient
+    {
+        weights_type weights;
+        vector_type bias;
+
+        void
+        clear()
+        {
+            weights.fill(T(0));
+            bias.fill(T(0));
+        }
+    };
+
+    //
+    //  Buffers of the batch passes, reused while the batch size is unchanged
+    //
+    struct batch_workspace
+    {
+        blas::matrix<T> neurons;
+        blas::matrix<T> gradient;
+        blas::matrix<T> delta;
+    };
+
+    layer()
+    :   _input_major(false)
+    {}
+
+    layer(size_t in_size, size_t out_size, order storage = output_major)
+    :   _weights(storage == input_major ? in_size : out_size, storage == input_major ? out_size : in_size),
+        _bias(out_size),
+        _input_major(storage == input_major),
+        _work(in_size, out_size)
     {
         randomize();
     }
@@ -49,7 +163,7 @@ public:
     {
         std::random_device rd;
         std::mt19937 gen(rd());
-        std::uniform_real_distribution<> dis(-1.0, 1.0);
+        std::uniform_real_distribution<T> dis(-1.0, 1.0);
 
         for (auto& w : _weights)
             w = dis(gen);
@@ -61,52 +175,444 @@ public:
     void
     activate()
     {
-        // positive sigmoid
-        for (auto& n : _neurons)
-            n = tanh(n);
+        _activate(_work.neurons);
     }
 
+    //
+    //  Workspace sized for this layer
+    //
+    workspace
+    make_workspace() const
+    {
+        return workspace(_input_major ? _weights.height() : _weights.width(), _bias.size());
+    }
+
+    template <typename _input>
+    void
+    feed_forward(const _input& input)
+    {
+        feed_forward(input, _work);
+    }
+
+    template <typename _alloc>
     void
-    feed_forward(const blas::vector<double>& input)
+    feed_forward(const blas::vector<T, _alloc>& input, workspace& work)
     {
-        _neurons = _weights * input + _bias;
-        activate();
+        work.neurons.resize(_bias.size());
+        blas::gemv<T>(_weights_view(), input, work.neurons);
+
+        work.neurons += _bias;
+        _activate(work.neurons);
     }
 
+    //
+    //  Reads only the weights of the nonzero inputs, whole rows when
+    //  the layer is input_major, else a gathered column per output
+    //
     void
-    backpropagate(const blas::vector<double>& input, blas::vector<double>& error, double learning_rate)
+    feed_forward(const blas::sparse_vector<T>& input, workspace& work)
+    {
+        if (_input_major)
+            _weights.transposed().multiply(input, work.neurons);
+        else
+            _weights.multiply(input, work.neurons);
+
+        work.neurons += _bias;
+        _activate(work.neurons);
+    }
+
+    //
+    //  Leaves the error for the previous layer in delta(); the first layer
+    //  has no use for it and skips it with propagate = false
+    //  input is a blas::vector or a blas::sparse_vector, which updates only
+    //  the weights of its nonzeros
+    //  Works in the layer's own buffers, sized at construction, so a training
+    //  step allocates nothing
+    //
+    template <typename _input, typename _ealloc>
+    void
+    backpropagate(const _input& input, const blas::vector<T, _ealloc>& error, T learning_rate, bool propagate = true)
+    {
+        backpropagate(input, error, learning_rate, _work, propagate);
+    }
+
+    //
+    //  Same in the buffers of work, which must hold the outputs of the last
+    //  feed_forward through it
+    //  Threads may each bring a workspace, but only one may update the layer
+    //  at a time; concurrent training goes through backpropagate_shared
+    //
+    template <typename _input, typename _ealloc>
+    void
+    backpropagate(const _input& input, const blas::vector<T, _ealloc>& error, T learning_rate, workspace& work, bool propagate = true)
     {
         // calculate error
-        blas::vector<double> delta = _weights.transpose() * error;
+        if (propagate)
+        {
+            work.delta.resize(_weights_view().width());
+            blas::gemv<T>(_weights_view().transposed(), error, work.delta);
+        }
 
         // calculate gradient
-        blas::vector<double> gradient = _neurons;
-        gradient = gradient * (1.0 - gradient);
-        gradient = gradient * error;
+        work.gradient = work.neurons * (work.neurons - T(1)) * error;
 
         // update weights
-        _weights = _weights + blas::vector<double>::outer_product(gradient, input) * learning_rate;
+        _update_weights(learning_rate, work.gradient, input);
 
         // update bias
-        _bias = _bias + gradient * learning_rate;
+        _bias.axpy(learning_rate, work.gradient);
+    }
+
+    //
+    //  feed_forward and backpropagate through the buffers of work for threads
+    //  that train the layer at once without locks (Hogwild!): the weights and
+    //  bias are only read and written through the kernels of blas/relaxed.hpp,
+    //  so an update may overwrite another thread's, but is never torn
+    //
+    template <typename _alloc>
+    void
+    feed_forward_shared(const blas::vector<T, _alloc>& input, workspace& work)
+    {
+        const blas::matrix_view<T> weights = _weights_view();
+
+        work.neurons.resize(_bias.size());
+        blas::kernel::relaxed_gemv<T>(
+            weights.height(), weights.width(), weights.data(), weights.row_stride(), weights.column_stride(),
+            input.data(), work.neurons.data()
+        );
 
-        // update error
-        error = delta;
+        blas::kernel::relaxed_add<T>(_bias.size(), _bias.data(), work.neurons.data());
+        _activate(work.neurons);
+    }
+
+    void
+    feed_forward_shared(const blas::sparse_vector<T>& input, workspace& work)
+    {
+        work.neurons.resize(_bias.size());
+
+        if (_input_major)
+            blas::kernel::relaxed_gemv_t_sparse<T>(
+                _weights.width(), _weights.data(), _weights.width(),
+                input.nonzeros(), input.indices(), input.values(), work.neurons.data()
+            );
+        else
+            blas::kernel::relaxed_gemv_sparse<T>(
+                _weights.height(), _weights.data(), _weights.width(),
+                input.nonzeros(), input.indices(), input.values(), work.neurons.data()
+            );
+
+        blas::kernel::relaxed_add<T>(_bias.size(), _bias.data(), work.neurons.data());
+        _activate(work.neurons);
+    }
+
+    template <typename _input, typename _ealloc>
+    void
+    backpropagate_shared(const _input& input, const blas::vector<T, _ealloc>& error, T learning_rate, workspace& work, bool propagate = true)
+    {
+        // calculate error
+        if (propagate)
+        {
+            const blas::matrix_view<T> weights = _weights_view().transposed();
+
+            work.delta.resize(weights.height());
+            blas::kernel::relaxed_gemv<T>(
+                weights.height(), weights.width(), weights.data(), weights.row_stride(), weights.column_stride(),
+                error.data(), work.delta.data()
+            );
+        }
+
+        // calculate gradient
+        work.gradient = work.neurons * (work.neurons - T(1)) * error;
+
+        // update weights
+        _update_weights_shared(learning_rate, work.gradient, input);
+
+        // update bias
+        blas::kernel::relaxed_axpy<T>(_bias.size(), learning_rate, work.gradient.data(), _bias.data());
+    }
+
+    //
+    //  Gradient of this layer's shape, zeroed
+    //
+    gradient
+    make_gradient() const
+    {
+        gradient g;
+        g.weights = weights_type(_weights.height(), _weights.width());
+        g.bias.resize(_bias.size());
+        g.clear();
+        return g;
+    }
+
+    //
+    //  weights += scale * g, bias likewise
+    //
+    void
+    apply(const gradient& g, T scale)
+    {
+        assert(g.weights.size() == _weights.size() and g.bias.size() == _bias.size());
+
+        blas::kernel::axpy<T>(_weights.size(), scale, g.weights.data(), _weights.data());
+        blas::kernel::axpy<T>(_bias.size(), scale, g.bias.data(), _bias.data());
+    }
+
+    //
+    //  Forward pass of a batch stored one sample per row:
+    //  N = tanh(X * W^T + b) with the bias added to every row
+    //
+    void
+    feed_forward_batch(const blas::matrix_view<const T>& inputs)
+    {
+        feed_forward_batch(inputs, _batch_work);
+    }
+
+    //
+    //  Same into the buffers of work, for threads sharing the layer
+    //
+    void
+    feed_forward_batch(const blas::matrix_view<const T>& inputs, batch_workspace& work)
+    {
+        work.neurons.resize(_bias.size(), inputs.height());
+
+        blas::gemm<T>(inputs, _weights_view().transposed(), work.neurons.view());
+
+        const size_t width = work.neurons.width();
+        T* neurons = work.neurons.data();
+        const T* bias = _bias.data();
+
+        blas::parallel_for(0, work.neurons.height(), blas::grain::rows(width), [=](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                for (size_t j = 0; j < width; ++j)
+                    neurons[i * width + j] += bias[j];
+        });
+
+        blas::kernel::tanh(work.neurons.size(), neurons, neurons);
+    }
+
+    //
+    //  Backward pass of a batch, same rules as backpropagate applied to every
+    //  row, with a single weight update by the mean gradient of the batch
+    //  The error for the previous layer goes to batch_delta(); the first
+    //  layer has no use for it and skips it with propagate = false
+    //
+    void
+    backpropagate_batch(const blas::matrix_view<const T>& inputs, const blas::matrix_view<const T>& error, T learning_rate, bool propagate = true)
+    {
+        // gradient scaled by the step size, then added to the weights
+        _batch_gradient(inputs, error, learning_rate / T(inputs.height()), _batch_work, propagate);
+        _add_batch_gradient(inputs, _batch_work, _weights, _bias);
+    }
+
+    //
+    //  Backward pass of a batch through the buffers of work that adds the
+    //  summed, unscaled updates of its rows to g; the weights stay as they are
+    //  The error for the previous layer goes to work.delta
+    //
+    void
+    accumulate_batch(const blas::matrix_view<const T>& inputs, const blas::matrix_view<const T>& error, gradient& g, batch_workspace& work, bool propagate = true)
+    {
+        _batch_gradient(inputs, error, T(1), work, propagate);
+        _add_batch_gradient(inputs, work, g.weights, g.bias);
     }
 
     // getters
 
-    const blas::vector<double>&
+    const vector_type&
     neurons() const
     {
-        return _neurons;
+        return _work.neurons;
+    }
+
+    //
+    //  Error for the previous layer left by the last backpropagate
+    //
+    const vector_type&
+    delta() const
+    {
+        return _work.delta;
+    }
+
+    const blas::matrix<T>&
+    batch_neurons() const
+    {
+        return _batch_work.neurons;
+    }
+
+    const blas::matrix<T>&
+    batch_delta() const
+    {
+        return _batch_work.delta;
+    }
+
+    //
+    //  The weights as stored, in the order of storage()
+    //
+    const weights_type&
+    weights() const
+    {
+        return _weights;
+    }
+
+    order
+    storage() const
+    {
+        return _input_major ? input_major : output_major;
+    }
+
+    //
+    //  Copy of the weights with one row per output whatever the storage
+    //  order; costs a full copy, and a transpose when input_major
+    //
+    blas::matrix<T>
+    output_major_weights() const
+    {
+        if (_input_major)
+            return _weights.transpose();
+        return _weights;
+    }
+
+    const vector_type&
+    bias() const
+    {
+        return _bias;
+    }
+
+    //
+    //  Bytes of the weights the kernel backs with huge pages
+    //
+    size_t
+    huge_page_bytes() const
+    {
+        return blas::huge_pages::granted(_weights.data());
     }
 
 private:
 
-    blas::vector<double> _neurons;
-    blas::matrix<double> _weights;
-    blas::vector<double> _bias;
+    static
+    void
+    _activate(vector_type& neurons)
+    {
+        blas::kernel::tanh(neurons.size(), neurons.data(), neurons.data());
+    }
+
+    //
+    //  Weights as outputs x inputs whatever the storage order
+    //
+    blas::matrix_view<T>
+    _weights_view()
+    {
+        return _input_major ? _weights.view().transposed() : _weights.view();
+    }
+
+    //
+    //  Error for the previous layer into work.delta and the gradient of
+    //  every row, times scale, into work.gradient
+    //
+    void
+    _batch_gradient(const blas::matrix_view<const T>& inputs, const blas::matrix_view<const T>& error, T scale, batch_workspace& work, bool propagate)
+    {
+        const size_t batch = inputs.height();
+
+        // calculate error
+        if (propagate)
+        {
+            work.delta.resize(_weights_view().width(), batch);
+            blas::gemm<T>(error, _weights_view(), work.delta.view());
+        }
+
+        // calculate gradient
+        work.gradient.resize(_bias.size(), batch);
+
+        const size_t width = work.gradient.width();
+        const T* neurons = work.neurons.data();
+        T* gradient = work.gradient.data();
+
+        blas::parallel_for(0, batch, blas::grain::rows(width), [=](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                for (size_t j = 0; j < width; ++j)
+                {
+                    const T n = neurons[i * width + j];
+                    gradient[i * width + j] = scale * n * (n - T(1)) * error(i, j);
+                }
+            }
+        });
+    }
+
+    //
+    //  weights += G^T * X and bias += the rows of G, for weights stored
+    //  like the layer's; the product is written in the storage order
+    //
+    void
+    _add_batch_gradient(const blas::matrix_view<const T>& inputs, const batch_workspace& work, weights_type& weights, vector_type& bias)
+    {
+        if (_input_major)
+            blas::gemm<T>(inputs.transposed(), work.gradient.view(), weights.view(), T(1));
+        else
+            blas::gemm<T>(work.gradient.view().transposed(), inputs, weights.view(), T(1));
+
+        for (size_t i = 0; i < inputs.height(); ++i)
+            blas::kernel::axpy<T>(bias.size(), T(1), work.gradient.row(i), bias.data());
+    }
+
+    template <typename _galloc, typename _alloc>
+    void
+    _update_weights(T learning_rate, const blas::vector<T, _galloc>& gradient, const blas::vector<T, _alloc>& input)
+    {
+        blas::ger<T>(learning_rate, gradient, input, _weights_view());
+    }
+
+    template <typename _galloc>
+    void
+    _update_weights(T learning_rate, const blas::vector<T, _galloc>& gradient, const blas::sparse_vector<T>& input)
+    {
+        if (_input_major)
+            _weights.rank1_update(learning_rate, input, gradient);
+        else
+            _weights.rank1_update(learning_rate, gradient, input);
+    }
+
+    template <typename _galloc, typename _alloc>
+    void
+    _update_weights_shared(T learning_rate, const blas::vector<T, _galloc>& gradient, const blas::vector<T, _alloc>& input)
+    {
+        const blas::matrix_view<T> weights = _weights_view();
+
+        blas::kernel::relaxed_ger<T>(
+            weights.height(), weights.width(), learning_rate, gradient.data(), input.data(),
+            weights.data(), weights.row_stride(), weights.column_stride()
+        );
+    }
+
+    template <typename _galloc>
+    void
+    _update_weights_shared(T learning_rate, const blas::vector<T, _galloc>& gradient, const blas::sparse_vector<T>& input)
+    {
+        if (_input_major)
+            blas::kernel::relaxed_ger_sparse<T>(
+                _weights.width(), learning_rate, input.nonzeros(), input.indices(), input.values(),
+                gradient.data(), _weights.data(), _weights.width()
+            );
+        else
+            blas::kernel::relaxed_ger_sparse_columns<T>(
+                _weights.height(), learning_rate, gradient.data(), input.nonzeros(), input.indices(), input.values(),
+                _weights.data(), _weights.width()
+            );
+    }
+
+    weights_type _weights;
+    vector_type _bias;
+
+    // _weights holds inputs x outputs, see order
+    bool _input_major;
+
+    // buffers of the layer's own passes
+    workspace _work;
+
+    // buffers of the layer's own batch passes
+    batch_workspace _batch_work;
 };
 
 } // namespace neural
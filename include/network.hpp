@@ -8,28 +8,91 @@
 namespace neural
 {
 
+//
+//  Passed first to the network constructor for inputs that are mostly
+//  zeros, given as blas::sparse_vectors: the first layer then stores its
+//  weights one row per input, see layer::order
+//
+struct sparse_input_t {};
+constexpr sparse_input_t sparse_input {};
+
+template <typename T = double>
 class network
 {
-    blas::vector<layer> _layers;
+public:
+
+    typedef T                                   value_type;
+    typedef layer<T>                            layer_type;
+    typedef typename layer_type::vector_type    vector_type;
+
+    //
+    //  Buffers of one training step over shared weights: a workspace per
+    //  layer and the output error; threads training one network bring one
+    //  each, see parallel_trainer
+    //
+    struct workspace
+    {
+        blas::vector<typename layer_type::workspace> layers;
+        vector_type error;
+    };
+
+    //
+    //  Buffers of a batch pass over shared weights, as workspace
+    //
+    struct batch_workspace
+    {
+        blas::vector<typename layer_type::batch_workspace> layers;
+        blas::matrix<T> error;
+    };
+
+    //
+    //  Summed updates of several samples, one layer::gradient per layer
+    //
+    struct gradient
+    {
+        blas::vector<typename layer_type::gradient> layers;
+
+        void
+        clear()
+        {
+            for (auto& l : layers)
+                l.clear();
+        }
+    };
+
+private:
+
+    blas::vector<layer_type> _layers;
+
+    // output error of the last sample
+    vector_type _error;
+
+    // output error of the last batch
+    blas::matrix<T> _batch_error;
 
 public:
 
     template <typename... Args>
     network(Args... args)
-    :   _layers(sizeof...(Args) - 1)
+    :   network(layer_type::output_major, { args... })
     {
         static_assert(sizeof...(Args) >= 2, "network must have at least two layers");
+    }
 
-        std::initializer_list<int> sizes = { args... };
-
-        auto prev = sizes.begin();
-        auto curr = prev + 1;
-        for (auto& l : _layers)
-            l = layer(*prev++, *curr++);
+    template <typename... Args>
+    network(sparse_input_t, Args... args)
+    :   network(layer_type::input_major, { args... })
+    {
+        static_assert(sizeof...(Args) >= 2, "network must have at least two layers");
     }
 
-    const blas::vector<double>&
-    feed_forward(const blas::vector<double>& input)
+    //
+    //  input is a blas::vector or, for inputs that are mostly zeros,
+    //  a blas::sparse_vector built once per sample
+    //
+    template <typename _input>
+    const vector_type&
+    feed_forward(const _input& input)
     {
         _layers[0].feed_forward(input);
 
@@ -41,21 +104,278 @@ public:
         return _layers.back().neurons();
     }
 
+    //
+    //  Forward pass of a batch stored one sample per row,
+    //  returns the outputs one per row
+    //
+    const blas::matrix<T>&
+    feed_forward_batch(const blas::matrix_view<const T>& inputs)
+    {
+        _layers[0].feed_forward_batch(inputs);
+
+        for (size_t i = 1; i < _layers.size(); ++i)
+        {
+            _layers[i].feed_forward_batch(_layers[i - 1].batch_neurons());
+        }
+
+        return _layers.back().batch_neurons();
+    }
+
+    //
+    //  Same through the buffers of work, leaving the layers' own untouched
+    //
+    template <typename _input>
+    const vector_type&
+    feed_forward(const _input& input, workspace& work)
+    {
+        _layers[0].feed_forward(input, work.layers[0]);
+
+        for (size_t i = 1; i < _layers.size(); ++i)
+        {
+            _layers[i].feed_forward(work.layers[i - 1].neurons, work.layers[i]);
+        }
+
+        return work.layers[_layers.size() - 1].neurons;
+    }
+
+    const blas::vector<layer_type>&
+    layers() const
+    {
+        return _layers;
+    }
+
+    workspace
+    make_workspace() const
+    {
+        workspace work;
+        work.layers.resize(_layers.size());
+        for (size_t i = 0; i < _layers.size(); ++i)
+            work.layers[i] = _layers[i].make_workspace();
+
+        work.error.resize(_error.size());
+        return work;
+    }
+
+    batch_workspace
+    make_batch_workspace() const
+    {
+        batch_workspace work;
+        work.layers.resize(_layers.size());
+        return work;
+    }
+
+    gradient
+    make_gradient() const
+    {
+        gradient g;
+        g.layers.resize(_layers.size());
+        for (size_t i = 0; i < _layers.size(); ++i)
+            g.layers[i] = _layers[i].make_gradient();
+        return g;
+    }
+
+    //
+    //  One training step on one sample; after the first step it allocates
+    //  nothing, every buffer is a workspace of the network or its layers
+    //
+    template <typename _input, typename _talloc>
     void
-    train(const blas::vector<double>& input, const blas::vector<double>& target, double learning_rate)
+    train(const _input& input, const blas::vector<T, _talloc>& target, T learning_rate)
     {
         feed_forward(input);
 
         // calculate error
-        blas::vector<double> error = _layers.back().neurons() - target;
-        error = error * error;
+        const vector_type& output = _layers.back().neurons();
+        _error = (output - target) * (output - target);
+
+        // backpropagate, each layer takes the error left by the one after it
+        const vector_type* error = &_error;
+        for (size_t i = _layers.size() - 1; i > 0; --i)
+        {
+            _layers[i].backpropagate(_layers[i - 1].neurons(), *error, learning_rate);
+            error = &_layers[i].delta();
+        }
+        _layers[0].backpropagate(input, *error, learning_rate, false);
+    }
+
+    //
+    //  Same through the buffers of work; the weights are updated in place,
+    //  so only one thread at a time may train the network this way
+    //
+    template <typename _input, typename _talloc>
+    void
+    train(const _input& input, const blas::vector<T, _talloc>& target, T learning_rate, workspace& work)
+    {
+        feed_forward(input, work);
+
+        // calculate error
+        const vector_type& output = work.layers[_layers.size() - 1].neurons;
+        work.error = (output - target) * (output - target);
+
+        // backpropagate, each layer takes the error left by the one after it
+        const vector_type* error = &work.error;
+        for (size_t i = _layers.size() - 1; i > 0; --i)
+        {
+            _layers[i].backpropagate(work.layers[i - 1].neurons, *error, learning_rate, work.layers[i]);
+            error = &work.layers[i].delta;
+        }
+        _layers[0].backpropagate(input, *error, learning_rate, work.layers[0], false);
+    }
+
+    //
+    //  Same for several threads training the network at once, each with its
+    //  own workspace, without locks (Hogwild!), see layer::backpropagate_shared
+    //
+    template <typename _input, typename _talloc>
+    void
+    train_shared(const _input& input, const blas::vector<T, _talloc>& target, T learning_rate, workspace& work)
+    {
+        _layers[0].feed_forward_shared(input, work.layers[0]);
+        for (size_t i = 1; i < _layers.size(); ++i)
+            _layers[i].feed_forward_shared(work.layers[i - 1].neurons, work.layers[i]);
+
+        // calculate error
+        const vector_type& output = work.layers[_layers.size() - 1].neurons;
+        work.error = (output - target) * (output - target);
 
-        // backpropagate
+        // backpropagate, each layer takes the error left by the one after it
+        const vector_type* error = &work.error;
         for (size_t i = _layers.size() - 1; i > 0; --i)
         {
-            _layers[i].backpropagate(_layers[i - 1].neurons(), error, learning_rate);
+            _layers[i].backpropagate_shared(work.layers[i - 1].neurons, *error, learning_rate, work.layers[i]);
+            error = &work.layers[i].delta;
+        }
+        _layers[0].backpropagate_shared(input, *error, learning_rate, work.layers[0], false);
+    }
+
+    //
+    //  The per-layer pieces of feed_forward and train through the buffers of
+    //  work, for callers that run the layers on different threads, see
+    //  pipeline_trainer; input is the sample, which only layer 0 reads
+    //
+    template <typename _input>
+    void
+    feed_forward_layer(size_t i, const _input& input, workspace& work)
+    {
+        if (i == 0)
+            _layers[0].feed_forward(input, work.layers[0]);
+        else
+            _layers[i].feed_forward(work.layers[i - 1].neurons, work.layers[i]);
+    }
+
+    //
+    //  Backward pass of layer i, after the one of layer i + 1 on the same
+    //  work; the last layer computes the output error from target first
+    //
+    template <typename _input, typename _talloc>
+    void
+    backpropagate_layer(size_t i, const _input& input, const blas::vector<T, _talloc>& target, T learning_rate, workspace& work)
+    {
+        const size_t last = _layers.size() - 1;
+
+        // calculate error
+        if (i == last)
+        {
+            const vector_type& output = work.layers[last].neurons;
+            work.error = (output - target) * (output - target);
+        }
+
+        const vector_type& error = i == last ? work.error : work.layers[i + 1].delta;
+
+        if (i == 0)
+            _layers[0].backpropagate(input, error, learning_rate, work.layers[0], false);
+        else
+            _layers[i].backpropagate(work.layers[i - 1].neurons, error, learning_rate, work.layers[i]);
+    }
+
+    //
+    //  Forward and backward pass of a batch through the buffers of work,
+    //  adding the summed updates of its rows to g; the weights are left as
+    //  they are, see data_parallel_trainer
+    //
+    void
+    accumulate_batch(const blas::matrix_view<const T>& inputs, const blas::matrix_view<const T>& targets, gradient& g, batch_workspace& work)
+    {
+        _layers[0].feed_forward_batch(inputs, work.layers[0]);
+        for (size_t i = 1; i < _layers.size(); ++i)
+            _layers[i].feed_forward_batch(work.layers[i - 1].neurons, work.layers[i]);
+
+        // calculate error
+        _squared_error(work.layers[_layers.size() - 1].neurons, targets, work.error);
+
+        // backpropagate, each layer takes the error left by the one after it
+        const blas::matrix<T>* error = &work.error;
+        for (size_t i = _layers.size() - 1; i > 0; --i)
+        {
+            _layers[i].accumulate_batch(work.layers[i - 1].neurons, *error, g.layers[i], work.layers[i]);
+            error = &work.layers[i].delta;
+        }
+        _layers[0].accumulate_batch(inputs, *error, g.layers[0], work.layers[0], false);
+    }
+
+    //
+    //  Adds scale * g to the weights and biases of every layer
+    //
+    void
+    apply(const gradient& g, T scale)
+    {
+        for (size_t i = 0; i < _layers.size(); ++i)
+            _layers[i].apply(g.layers[i], scale);
+    }
+
+    //
+    //  One training step on a mini-batch of samples and targets stored one per
+    //  row; both passes are matrix products and the weights are updated once,
+    //  by the mean gradient of the batch
+    //
+    void
+    train_batch(const blas::matrix_view<const T>& inputs, const blas::matrix_view<const T>& targets, T learning_rate)
+    {
+        feed_forward_batch(inputs);
+
+        // calculate error
+        _squared_error(_layers.back().batch_neurons(), targets, _batch_error);
+
+        // backpropagate, each layer takes the error left by the one after it
+        const blas::matrix<T>* error = &_batch_error;
+        for (size_t i = _layers.size() - 1; i > 0; --i)
+        {
+            _layers[i].backpropagate_batch(_layers[i - 1].batch_neurons(), *error, learning_rate);
+            error = &_layers[i].batch_delta();
+        }
+        _layers[0].backpropagate_batch(inputs, *error, learning_rate, false);
+    }
+
+private:
+
+    //
+    //  Layers of the given sizes, the first stored in the given order
+    //
+    network(typename layer_type::order first, std::initializer_list<int> sizes)
+    :   _layers(sizes.size() - 1)
+    {
+        auto size = sizes.begin();
+        for (size_t i = 0; i < _layers.size(); ++i, ++size)
+            _layers[i] = layer_type(size[0], size[1], i == 0 ? first : layer_type::output_major);
+
+        _error.resize(_layers.back().neurons().size());
+    }
+
+    static
+    void
+    _squared_error(const blas::matrix<T>& output, const blas::matrix_view<const T>& targets, blas::matrix<T>& error)
+    {
+        assert(targets.height() == output.height() and targets.width() == output.width());
+
+        error.resize(output.width(), output.height());
+        for (size_t i = 0; i < output.height(); ++i)
+        {
+            for (size_t j = 0; j < output.width(); ++j)
+            {
+                const T difference = output[i][j] - targets(i, j);
+                error[i][j] = difference * difference;
+            }
         }
-        _layers[0].backpropagate(input, error, learning_rate);
     }
 
 };
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "blas/vector.hpp"
+#include "blas/thread_pool.hpp"
+
+#include "network.hpp"
+
+namespace neural
+{
+
+//
+//  Lock-free multi-threaded SGD over one shared network (Hogwild!)
+//  Every epoch shuffles the samples and deals them into one shard per
+//  thread; each thread runs network::train_shared on its shard in its own
+//  workspace, straight against the shared weights, without locks
+//  One update may overwrite another, see blas/relaxed.hpp, which costs a
+//  little accuracy per step and buys throughput that grows with the core count
+//  The calling thread is one of the workers, the others live as long as the
+//  trainer; with several workers their BLAS loops run inline, the
+//  parallelism is across samples, a single one trains exactly as
+//  network::train does on the same order, on the pool
+//
+template <typename T = double>
+class parallel_trainer
+{
+public:
+
+    typedef T           value_type;
+    typedef network<T>  network_type;
+
+private:
+
+    // workspaces of neighbouring threads must not share cache lines
+    struct alignas(64) slot
+    {
+        typename network_type::workspace work;
+    };
+
+    network_type& _network;
+    blas::vector<slot> _slots;
+    blas::vector<size_t> _order;
+    std::mt19937 _random;
+
+    // the workers wait for a new epoch, run shard t of it and report back
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _finish;
+
+    void (*_invoke)(const void*, size_t);
+    const void* _shard;
+    size_t _epoch;
+    size_t _running;
+    bool _stop;
+
+public:
+
+    //
+    //  threads = 0 takes one per hardware thread; seed fixes the order of the
+    //  samples in every epoch
+    //
+    explicit
+    parallel_trainer(network_type& net, size_t threads = 0, unsigned seed = std::random_device()())
+    :   _network(net),
+        _random(seed),
+        _invoke(nullptr),
+        _shard(nullptr),
+        _epoch(0),
+        _running(0),
+        _stop(false)
+    {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+
+        _slots.resize(threads);
+        for (auto& s : _slots)
+            s.work = _network.make_workspace();
+
+        for (size_t t = 1; t < threads; ++t)
+            _workers.emplace_back([this, t] { _worker(t); });
+    }
+
+    parallel_trainer(const parallel_trainer&) = delete;
+    parallel_trainer& operator = (const parallel_trainer&) = delete;
+
+    ~parallel_trainer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+
+        for (auto& w : _workers)
+            w.join();
+    }
+
+    size_t
+    threads() const
+    {
+        return _slots.size();
+    }
+
+    //
+    //  One epoch over all samples; inputs are blas::vectors or
+    //  blas::sparse_vectors, targets blas::vectors
+    //  Returns the throughput in samples per second
+    //
+    template <typename _input, typename _target>
+    double
+    train(const blas::vector<_input>& inputs, const blas::vector<_target>& targets, T learning_rate)
+    {
+        assert(inputs.size() == targets.size());
+
+        const size_t count = inputs.size();
+        if (count == 0) return 0.0;
+
+        _order.resize(count);
+        for (size_t i = 0; i < count; ++i)
+            _order[i] = i;
+        std::shuffle(_order.begin(), _order.end(), _random);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        auto shard = [&](size_t t)
+        {
+            blas::serial_region serial(_slots.size() > 1);
+            typename network_type::workspace& work = _slots[t].work;
+
+            const size_t begin = count * t / _slots.size();
+            const size_t end = count * (t + 1) / _slots.size();
+            for (size_t i = begin; i < end; ++i)
+                _network.train_shared(inputs[_order[i]], targets[_order[i]], learning_rate, work);
+        };
+
+        _run(shard);
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() > 0.0 ? count / elapsed.count() : 0.0;
+    }
+
+private:
+
+    //
+    //  Runs shard(t) on worker t for every t > 0 and shard(0) on the caller,
+    //  returns when all are done
+    //
+    template <typename F>
+    void
+    _run(const F& shard)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _invoke = [](const void* f, size_t t) { (*static_cast<const F*>(f))(t); };
+            _shard = &shard;
+            _running = _workers.size();
+            ++_epoch;
+        }
+        _start.notify_all();
+
+        shard(0);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _finish.wait(lock, [this] { return _running == 0; });
+    }
+
+    void
+    _worker(size_t t)
+    {
+        size_t epoch = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start.wait(lock, [&] { return _stop or _epoch != epoch; });
+                if (_stop) return;
+                epoch = _epoch;
+            }
+
+            _invoke(_shard, t);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_running == 0)
+                _finish.notify_one();
+        }
+    }
+};
+
+} // namespace neural
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "blas/vector.hpp"
+#include "blas/spsc_queue.hpp"
+#include "blas/thread_pool.hpp"
+
+#include "network.hpp"
+
+namespace neural
+{
+
+//
+//  Pipeline-parallel training and inference: one thread per layer, each
+//  running the forward and backward pass of its own layer, so layer i works
+//  on sample n while layer i + 1 works on sample n - 1
+//  Samples travel as indices through lock-free SPSC queues, forward from
+//  stage i to i + 1 and backward from i + 1 to i; the last stage turns a
+//  forward pass straight into a backward one. Every sample in flight has its
+//  own workspace, and only stage i touches layer i, so nothing is locked
+//  Up to in_flight samples are in the pipeline at once. A layer may run a
+//  sample forward before the updates of earlier samples have come back to
+//  it, the usual staleness of asynchronous pipelines; in_flight = 1 gives
+//  the same weights as network::train over the same samples
+//  Worth it for deep, narrow networks whose layers are too small to split;
+//  it needs a core per layer, the calling thread runs layer 0 and the others
+//  live as long as the trainer
+//  A stage with nothing to do spins a little, then sleeps until a sample is
+//  pushed to it
+//
+template <typename T = double>
+class pipeline_trainer
+{
+public:
+
+    typedef T                                   value_type;
+    typedef network<T>                          network_type;
+    typedef typename network_type::vector_type  vector_type;
+
+private:
+
+    typedef blas::spsc_queue<size_t> queue_type;
+
+    // sample index that ends a run
+    static constexpr size_t _stop = size_t(-1);
+
+    // polls of its empty queues before a stage goes to sleep
+    static constexpr size_t _spins = 64;
+
+    //
+    //  Sleep of one stage on its queues: the stage announces that it sleeps,
+    //  looks at its queues once more and waits for a ring; producers ring
+    //  after every push. The fences order the announcement against the push,
+    //  so either the stage sees the sample or the producer sees it asleep
+    //
+    class alignas(64) bell
+    {
+        std::mutex _mutex;
+        std::condition_variable _ring;
+        std::atomic<bool> _sleeping;
+        bool _rung;
+
+    public:
+
+        bell()
+        :   _sleeping(false),
+            _rung(false)
+        {
+        }
+
+        template <typename F>
+        void
+        wait(const F& ready)
+        {
+            _sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!ready())
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _ring.wait(lock, [this] { return _rung; });
+                _rung = false;
+            }
+
+            _sleeping.store(false, std::memory_order_relaxed);
+        }
+
+        void
+        ring()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!_sleeping.load(std::memory_order_relaxed)) return;
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _rung = true;
+            }
+            _ring.notify_one();
+        }
+    };
+
+    // workspaces of neighbouring samples must not share cache lines
+    struct alignas(64) slot
+    {
+        typename network_type::workspace work;
+    };
+
+    network_type& _network;
+    blas::vector<slot> _slots;
+
+    // _forward[i] runs from stage i to i + 1, _backward[i] from i + 1 to i,
+    // _done from the last stage to the first when nothing is trained
+    std::vector<std::unique_ptr<queue_type>> _forward;
+    std::vector<std::unique_ptr<queue_type>> _backward;
+    std::unique_ptr<queue_type> _done;
+    std::vector<std::unique_ptr<bell>> _bells;
+
+    // stage i > 0 waits for a new run, runs its part of it and reports back
+    std::vector<std::thread> _stages;
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _finished;
+
+    void (*_invoke)(const void*, size_t);
+    const void* _job;
+    size_t _epoch;
+    size_t _running;
+    bool _exit;
+
+public:
+
+    //
+    //  in_flight = 0 takes two samples per layer, enough to keep every
+    //  stage busy
+    //
+    explicit
+    pipeline_trainer(network_type& net, size_t in_flight = 0)
+    :   _network(net),
+        _invoke(nullptr),
+        _job(nullptr),
+        _epoch(0),
+        _running(0),
+        _exit(false)
+    {
+        const size_t stages = _network.layers().size();
+        if (in_flight == 0) in_flight = 2 * stages;
+
+        _slots.resize(in_flight);
+        for (auto& s : _slots)
+            s.work = _network.make_workspace();
+
+        // room for every sample in flight and the stop
+        for (size_t i = 0; i + 1 < stages; ++i)
+        {
+            _forward.emplace_back(new queue_type(in_flight + 1));
+            _backward.emplace_back(new queue_type(in_flight + 1));
+        }
+        _done.reset(new queue_type(in_flight + 1));
+
+        for (size_t i = 0; i < stages; ++i)
+            _bells.emplace_back(new bell);
+
+        for (size_t i = 1; i < stages; ++i)
+            _stages.emplace_back([this, i] { _stage_thread(i); });
+    }
+
+    pipeline_trainer(const pipeline_trainer&) = delete;
+    pipeline_trainer& operator = (const pipeline_trainer&) = delete;
+
+    ~pipeline_trainer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _exit = true;
+        }
+        _start.notify_all();
+
+        for (auto& s : _stages)
+            s.join();
+    }
+
+    size_t
+    in_flight() const
+    {
+        return _slots.size();
+    }
+
+    //
+    //  One pass over all samples in order; inputs are blas::vectors or
+    //  blas::sparse_vectors, targets blas::vectors
+    //  Returns the throughput in samples per second
+    //
+    template <typename _input, typename _target>
+    double
+    train(const blas::vector<_input>& inputs, const blas::vector<_target>& targets, T learning_rate)
+    {
+        assert(inputs.size() == targets.size());
+        return _run(inputs, &targets, (blas::vector<_target>*)nullptr, learning_rate);
+    }
+
+    //
+    //  Outputs of all samples into blas::vectors, one per input
+    //  Returns the throughput in samples per second
+    //
+    template <typename _input, typename _output>
+    double
+    feed_forward(const blas::vector<_input>& inputs, blas::vector<_output>& outputs)
+    {
+        outputs.resize(inputs.size());
+        return _run(inputs, (const blas::vector<_output>*)nullptr, &outputs, T(0));
+    }
+
+private:
+
+    typename network_type::workspace&
+    _work(size_t sample)
+    {
+        return _slots[sample % _slots.size()].work;
+    }
+
+    //
+    //  Pushes to stage consumer through q, which is sized for every sample in
+    //  flight and should never fill; if it does, waits for room rather than
+    //  lose the sample
+    //
+    void
+    _push(queue_type& q, size_t consumer, size_t sample)
+    {
+        while (!q.push(sample))
+            std::this_thread::yield();
+
+        _bells[consumer]->ring();
+    }
+
+    //
+    //  Spins on a stage's empty queues for a while, then sleeps until ready()
+    //
+    template <typename F>
+    void
+    _idle(size_t stage, size_t& spins, const F& ready)
+    {
+        if (++spins < _spins)
+        {
+            std::this_thread::yield();
+            return;
+        }
+
+        _bells[stage]->wait(ready);
+        spins = 0;
+    }
+
+    //
+    //  Trains when targets is given, else writes outputs
+    //
+    template <typename _input, typename _target, typename _output>
+    double
+    _run(const blas::vector<_input>& inputs, const blas::vector<_target>* targets, blas::vector<_output>* outputs, T learning_rate)
+    {
+        const size_t count = inputs.size();
+        if (count == 0) return 0.0;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        auto stage = [&](size_t i)
+        {
+            _stage(i, inputs, targets, outputs, learning_rate);
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _invoke = [](const void* f, size_t i) { (*static_cast<const decltype(stage)*>(f))(i); };
+            _job = &stage;
+            _running = _stages.size();
+            ++_epoch;
+        }
+        _start.notify_all();
+
+        _first_stage(inputs, targets, outputs, learning_rate);
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _finished.wait(lock, [this] { return _running == 0; });
+        }
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() > 0.0 ? count / elapsed.count() : 0.0;
+    }
+
+    void
+    _stage_thread(size_t i)
+    {
+        size_t epoch = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start.wait(lock, [&] { return _exit or _epoch != epoch; });
+                if (_exit) return;
+                epoch = _epoch;
+            }
+
+            _invoke(_job, i);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_running == 0)
+                _finished.notify_one();
+        }
+    }
+
+    //
+    //  Work of the last layer once its forward pass is done
+    //
+    template <typename _input, typename _target, typename _output>
+    void
+    _finish(size_t sample, const blas::vector<_input>& inputs, const blas::vector<_target>* targets, blas::vector<_output>* outputs, T learning_rate)
+    {
+        const size_t last = _network.layers().size() - 1;
+        typename network_type::workspace& work = _work(sample);
+
+        if (targets)
+            _network.backpropagate_layer(last, inputs[sample], (*targets)[sample], learning_rate, work);
+        else
+            (*outputs)[sample] = work.layers[last].neurons;
+    }
+
+    //
+    //  Layer 0, on the calling thread: feeds the samples in order while
+    //  fewer than in_flight are in the pipeline and takes them back at the end
+    //
+    template <typename _input, typename _target, typename _output>
+    void
+    _first_stage(const blas::vector<_input>& inputs, const blas::vector<_target>* targets, blas::vector<_output>* outputs, T learning_rate)
+    {
+        blas::serial_region serial;
+
+        const size_t count = inputs.size();
+        const bool single = _network.layers().size() == 1;
+        queue_type* returned = single ? nullptr : targets ? _backward[0].get() : _done.get();
+
+        size_t issued = 0, finished = 0, spins = 0;
+        while (finished < count)
+        {
+            size_t sample;
+            if (returned and returned->pop(sample))
+            {
+                if (targets)
+                    _network.backpropagate_layer(0, inputs[sample], (*targets)[sample], learning_rate, _work(sample));
+                ++finished;
+                spins = 0;
+            }
+            else if (issued < count and issued - finished < _slots.size())
+            {
+                sample = issued++;
+                spins = 0;
+                _network.feed_forward_layer(0, inputs[sample], _work(sample));
+
+                if (single)
+                {
+                    _finish(sample, inputs, targets, outputs, learning_rate);
+                    ++finished;
+                }
+                else
+                {
+                    _push(*_forward[0], 1, sample);
+                }
+            }
+            else
+            {
+                // only a returning sample lets anything more happen
+                _idle(0, spins, [returned] { return !returned->empty(); });
+            }
+        }
+
+        if (!single)
+            _push(*_forward[0], 1, _stop);
+    }
+
+    //
+    //  Layer i > 0 on its own thread; backward passes go first, they free
+    //  the workspaces that let new samples in
+    //
+    template <typename _input, typename _target, typename _output>
+    void
+    _stage(size_t i, const blas::vector<_input>& inputs, const blas::vector<_target>* targets, blas::vector<_output>* outputs, T learning_rate)
+    {
+        blas::serial_region serial;
+
+        const size_t last = _network.layers().size() - 1;
+
+        auto ready = [this, i, last]
+        {
+            return (i < last and !_backward[i]->empty()) or !_forward[i - 1]->empty();
+        };
+
+        size_t spins = 0;
+        for (;;)
+        {
+            size_t sample;
+            if (i < last and _backward[i]->pop(sample))
+            {
+                _network.backpropagate_layer(i, inputs[sample], (*targets)[sample], learning_rate, _work(sample));
+                _push(*_backward[i - 1], i - 1, sample);
+                spins = 0;
+            }
+            else if (_forward[i - 1]->pop(sample))
+            {
+                // the first stage stops once every sample has come back
+                if (sample == _stop)
+                {
+                    if (i < last) _push(*_forward[i], i + 1, _stop);
+                    return;
+                }
+
+                _network.feed_forward_layer(i, inputs[sample], _work(sample));
+
+                if (i < last)
+                {
+                    _push(*_forward[i], i + 1, sample);
+                }
+                else
+                {
+                    _finish(sample, inputs, targets, outputs, learning_rate);
+                    if (targets)
+                        _push(*_backward[i - 1], i - 1, sample);
+                    else
+                        _push(*_done, 0, sample);
+                }
+                spins = 0;
+            }
+            else
+            {
+                _idle(i, spins, ready);
+            }
+        }
+    }
+};
+
+} // namespace neural
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "blas/vector.hpp"
+#include "blas/matrix.hpp"
+#include "blas/quantized_matrix.hpp"
+#include "blas/half_matrix.hpp"
+#include "blas/sparse_matrix.hpp"
+
+#include "network.hpp"
+
+namespace neural
+{
+
+//
+//  Inference-only copy of a trained layer with compressed weights,
+//  int8 by default (blas::quantized_matrix), half-width (blas::half_matrix)
+//  or pruned (blas::sparse_matrix); extra arguments go to the weights
+//  Biases and activations stay in T
+//
+template <typename T = double, typename W = blas::quantized_matrix<T>>
+class quantized_layer
+{
+public:
+
+    typedef T                                   value_type;
+    typedef W                                   weights_type;
+    typedef typename layer<T>::vector_type      vector_type;
+
+    quantized_layer() {}
+
+    template <typename... Args>
+    explicit
+    quantized_layer(const layer<T>& l, const Args&... args)
+    :   _neurons(l.bias().size()),
+        _weights(l.output_major_weights(), args...),
+        _bias(l.bias())
+    {}
+
+    void
+    activate()
+    {
+        blas::kernel::tanh(_neurons.size(), _neurons.data(), _neurons.data());
+    }
+
+    template <typename _alloc>
+    void
+    feed_forward(const blas::vector<T, _alloc>& input)
+    {
+        _weights.multiply(input, _neurons);
+        _neurons += _bias;
+        activate();
+    }
+
+    // getters
+
+    const vector_type&
+    neurons() const
+    {
+        return _neurons;
+    }
+
+    const weights_type&
+    weights() const
+    {
+        return _weights;
+    }
+
+private:
+
+    vector_type _neurons;
+    weights_type _weights;
+    vector_type _bias;
+};
+
+//
+//  Post-training quantized network for serving: by default weights are int8
+//  with a scale per row and products accumulate in int32; with a half_matrix
+//  they are bf16 / fp16 accumulated in float
+//
+template <typename T = double, typename W = blas::quantized_matrix<T>>
+class quantized_network
+{
+public:
+
+    typedef T                                           value_type;
+    typedef quantized_layer<T, W>                       layer_type;
+    typedef typename layer_type::vector_type            vector_type;
+
+private:
+
+    blas::vector<layer_type> _layers;
+
+public:
+
+    template <typename... Args>
+    explicit
+    quantized_network(const network<T>& net, const Args&... args)
+    :   _layers(net.layers().size())
+    {
+        for (size_t i = 0; i < _layers.size(); ++i)
+            _layers[i] = layer_type(net.layers()[i], args...);
+    }
+
+    const vector_type&
+    feed_forward(const blas::vector<T>& input)
+    {
+        _layers[0].feed_forward(input);
+
+        for (size_t i = 1; i < _layers.size(); ++i)
+        {
+            _layers[i].feed_forward(_layers[i - 1].neurons());
+        }
+
+        return _layers.back().neurons();
+    }
+
+    //
+    //  Bytes of weights one forward pass streams
+    //
+    size_t
+    weight_bytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& l : _layers)
+            bytes += l.weights().bytes();
+        return bytes;
+    }
+};
+
+//
+//  Network with bfloat16 (default) or float16 weights
+//
+template <typename T = double, typename H = blas::bfloat16>
+using half_network = quantized_network<T, blas::half_matrix<T, H>>;
+
+//
+//  Network with magnitude-pruned CSR weights, constructed with the fraction
+//  of weights to keep in every layer: sparse_network<double> net(trained, 0.1)
+//
+template <typename T = double>
+using sparse_network = quantized_network<T, blas::sparse_matrix<T>>;
+
+} // namespace neural
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <random>
+
+#include "blas/static_vector.hpp"
+#include "blas/static_matrix.hpp"
+#include "blas/activation.hpp"
+
+namespace neural
+{
+
+//
+//  Fully connected tanh layer with its shape fixed at compile time
+//  Same arithmetic as layer, on storage inside the object: the products run
+//  the fixed-shape kernels and a training step allocates nothing
+//
+template <typename T, size_t _in, size_t _out>
+class static_layer
+{
+public:
+
+    typedef T                               value_type;
+    typedef blas::static_vector<T, _in>     input_type;
+    typedef blas::static_vector<T, _out>    vector_type;
+    typedef blas::static_matrix<T, _out, _in> weights_type;
+
+    static constexpr size_t inputs = _in;
+    static constexpr size_t outputs = _out;
+
+    static_layer()
+    {
+        randomize();
+    }
+
+    void
+    randomize()
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_real_distribution<T> dis(-1.0, 1.0);
+
+        for (auto& w : _weights)
+            w = dis(gen);
+
+        for (auto& b : _bias)
+            b = dis(gen);
+    }
+
+    //
+    //  Copies the weights, outputs x inputs row-major, and the bias of a
+    //  layer of the same shape, e.g. the output_major_weights() and bias()
+    //  of a layer
+    //
+    template <typename _weights_source, typename _bias_source>
+    void
+    assign(const _weights_source& weights, const _bias_source& bias)
+    {
+        assert(weights.size() == _out * _in and bias.size() == _out);
+
+        std::copy(weights.data(), weights.data() + _out * _in, _weights.data());
+        std::copy(bias.data(), bias.data() + _out, _bias.data());
+    }
+
+    void
+    activate()
+    {
+        blas::kernel::tanh(_out, _neurons.data(), _neurons.data());
+    }
+
+    //
+    //  input is anything holding _in contiguous elements behind data(),
+    //  a static_vector or a blas::vector
+    //
+    template <typename _input>
+    void
+    feed_forward(const _input& input)
+    {
+        assert(input.size() == _in);
+
+        blas::kernel::static_gemv<_out, _in>(_weights.data(), input.data(), _neurons.data());
+
+        for (size_t i = 0; i < _out; ++i)
+            _neurons[i] += _bias[i];
+        activate();
+    }
+
+    //
+    //  Updates the weights and bias from the error of this layer's outputs
+    //  and writes the error for the previous layer into delta
+    //
+    template <typename _input>
+    void
+    backpropagate(const _input& input, const vector_type& error, T learning_rate, input_type& delta)
+    {
+        _weights.multiply_transposed(error, delta);
+        backpropagate(input, error, learning_rate);
+    }
+
+    //
+    //  Same without the error for the previous layer, for the first layer
+    //
+    template <typename _input>
+    void
+    backpropagate(const _input& input, const vector_type& error, T learning_rate)
+    {
+        assert(input.size() == _in);
+
+        // calculate gradient
+        vector_type gradient;
+        for (size_t i = 0; i < _out; ++i)
+            gradient[i] = _neurons[i] * (_neurons[i] - T(1)) * error[i];
+
+        // update weights
+        blas::kernel::static_ger<_out, _in>(learning_rate, gradient.data(), input.data(), _weights.data());
+
+        // update bias
+        for (size_t i = 0; i < _out; ++i)
+            _bias[i] += learning_rate * gradient[i];
+    }
+
+    // getters
+
+    const vector_type&
+    neurons() const
+    {
+        return _neurons;
+    }
+
+    const weights_type&
+    weights() const
+    {
+        return _weights;
+    }
+
+    const vector_type&
+    bias() const
+    {
+        return _bias;
+    }
+
+private:
+
+    vector_type _neurons;
+    weights_type _weights;
+    vector_type _bias;
+};
+
+} // namespace neural
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+#include "blas/static_vector.hpp"
+
+#include "static_layer.hpp"
+
+namespace neural
+{
+
+//
+//  Network with its layer sizes fixed at compile time, the counterpart of
+//  network for shapes known up front: static_network<784, 128, 10>
+//  Layers, activations and errors all live inside the object, nothing is
+//  allocated after construction; the weights of a wide layer make the object
+//  large, so keep it static or on the heap rather than on a thread's stack
+//
+template <typename T, size_t... _sizes>
+class basic_static_network
+{
+    static_assert(sizeof...(_sizes) >= 2, "network must have at least two layers");
+
+    static constexpr size_t _size[] = { _sizes... };
+    static constexpr size_t _depth = sizeof...(_sizes) - 1;
+
+    template <size_t... I>
+    static
+    std::tuple<static_layer<T, _size[I], _size[I + 1]>...>
+    _layers_of(std::index_sequence<I...>);
+
+    template <size_t... I>
+    static
+    std::tuple<blas::static_vector<T, _size[I + 1]>...>
+    _errors_of(std::index_sequence<I...>);
+
+public:
+
+    typedef T value_type;
+
+    // one static_layer per pair of consecutive sizes
+    typedef decltype(_layers_of(std::make_index_sequence<_depth>())) layers_type;
+
+    typedef blas::static_vector<T, _size[0]>        input_type;
+    typedef blas::static_vector<T, _size[_depth]>   vector_type;
+
+private:
+
+    layers_type _layers;
+
+    // error of every layer's outputs during a training step
+    decltype(_errors_of(std::make_index_sequence<_depth>())) _errors;
+
+public:
+
+    //
+    //  input is a static_vector or a blas::vector of the first size
+    //
+    template <typename _input>
+    const vector_type&
+    feed_forward(const _input& input)
+    {
+        std::get<0>(_layers).feed_forward(input);
+        _forward<1>();
+
+        return std::get<_depth - 1>(_layers).neurons();
+    }
+
+    const layers_type&
+    layers() const
+    {
+        return _layers;
+    }
+
+    layers_type&
+    layers()
+    {
+        return _layers;
+    }
+
+    template <typename _input, typename _target>
+    void
+    train(const _input& input, const _target& target, T learning_rate)
+    {
+        feed_forward(input);
+
+        // calculate error
+        const vector_type& output = std::get<_depth - 1>(_layers).neurons();
+        vector_type& error = std::get<_depth - 1>(_errors);
+        for (size_t i = 0; i < output.size(); ++i)
+            error[i] = (output[i] - target[i]) * (output[i] - target[i]);
+
+        // backpropagate
+        _backward<_depth - 1>(learning_rate);
+        std::get<0>(_layers).backpropagate(input, std::get<0>(_errors), learning_rate);
+    }
+
+private:
+
+    template <size_t I>
+    void
+    _forward()
+    {
+        if constexpr (I < _depth)
+        {
+            std::get<I>(_layers).feed_forward(std::get<I - 1>(_layers).neurons());
+            _forward<I + 1>();
+        }
+    }
+
+    //
+    //  Layers I down to 1, each leaving the error of its inputs for layer I - 1
+    //
+    template <size_t I>
+    void
+    _backward(T learning_rate)
+    {
+        if constexpr (I > 0)
+        {
+            std::get<I>(_layers).backpropagate(std::get<I - 1>(_layers).neurons(), std::get<I>(_errors), learning_rate, std::get<I - 1>(_errors));
+            _backward<I - 1>(learning_rate);
+        }
+    }
+};
+
+template <size_t... _sizes>
+using static_network = basic_static_network<double, _sizes...>;
+
+} // namespace neural
@@ -1,46 +1,98 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <algorithm>
 
 #include "network.hpp"
+#include "quantized_network.hpp"
 
 void
 read_train_data(const std::string& path, blas::vector<blas::vector<double>>& inputs, blas::vector<blas::vector<double>>& targets);
 
+template <typename Model, typename Input>
+double
+accuracy(Model& model, const blas::vector<Input>& inputs, blas::vector<blas::vector<double>>& targets, size_t count);
+
+blas::matrix<double>
+stack(const blas::vector<blas::vector<double>>& rows);
+
 int main()
 {
-    neural::network net(784, 10);
+    neural::network<double> net(784, 10);
 
     // load training data
     blas::vector<blas::vector<double>> inputs;
     blas::vector<blas::vector<double>> targets;
     read_train_data("../dataset/", inputs, targets);
 
+    // one sample per row, a mini-batch is a view of consecutive rows
+    const blas::matrix<double> images = stack(inputs);
+    const blas::matrix<double> labels = stack(targets);
+    const size_t batch = 32;
+
+    // train_batch steps by the mean gradient of a batch; scaling the rate by
+    // the batch size keeps the step of an epoch that of per-sample training at 0.1
+    const double learning_rate = 0.1 * batch;
+
     for (int i = 0; i < 5; ++i)
     {
-        for (size_t j = 0; j < inputs.size(); ++j)
+        for (size_t j = 0; j < images.height(); j += batch)
         {
-            std::cout << '\r' << "epoch " << i + 1 << " training: " << j << '/' << inputs.size() << std::flush;
-            net.train(inputs[j], targets[j], 0.1);
+            const size_t size = std::min<size_t>(batch, images.height() - j);
+
+            std::cout << '\r' << "epoch " << i + 1 << " training: " << j << '/' << images.height() << std::flush;
+            net.train_batch(images.view().rows(j, size), labels.view().rows(j, size), learning_rate);
         }
     }
     std::cout << std::endl;
 
-    // test on first 60000 training data
+    // test on first 60000 training data, full precision, int8, bf16 and pruned weights
+    const size_t count = std::min<size_t>(60000, inputs.size());
+
+    neural::quantized_network<double> qnet(net);
+    neural::half_network<double> hnet(net);
+    neural::sparse_network<double> snet(net, 0.25);
+
+    // most pixels are zero, the full precision network reads only the others
+    blas::vector<blas::sparse_vector<double>> sparse_inputs(count);
+    for (size_t i = 0; i < count; ++i)
+        sparse_inputs[i].assign(inputs[i]);
+
+    std::cout << "accuracy: " << accuracy(net, sparse_inputs, targets, count) * 100.0 << '%' << std::endl;
+    std::cout << "int8 accuracy: " << accuracy(qnet, inputs, targets, count) * 100.0 << '%'
+              << " (" << qnet.weight_bytes() << " weight bytes)" << std::endl;
+    std::cout << "bf16 accuracy: " << accuracy(hnet, inputs, targets, count) * 100.0 << '%'
+              << " (" << hnet.weight_bytes() << " weight bytes)" << std::endl;
+    std::cout << "25% pruned accuracy: " << accuracy(snet, inputs, targets, count) * 100.0 << '%'
+              << " (" << snet.weight_bytes() << " weight bytes)" << std::endl;
+
+    return 0;
+}
+
+template <typename Model, typename Input>
+double
+accuracy(Model& model, const blas::vector<Input>& inputs, blas::vector<blas::vector<double>>& targets, size_t count)
+{
     size_t correct = 0;
-    for (size_t i = 0; i < 60000; ++i)
+    for (size_t i = 0; i < count; ++i)
     {
-        auto output = net.feed_forward(inputs[i]);
+        const auto& output = model.feed_forward(inputs[i]);
         auto max = std::max_element(output.begin(), output.end());
         auto target = std::max_element(targets[i].begin(), targets[i].end());
-        if (*max == *target)
+        if (max - output.begin() == target - targets[i].begin())
             ++correct;
-
     }
 
-    std::cout << "accuracy: " << correct / 60000.0 * 100.0 << '%' << std::endl;
+    return count ? correct / double(count) : 0.0;
+}
 
-    return 0;
+blas::matrix<double>
+stack(const blas::vector<blas::vector<double>>& rows)
+{
+    blas::matrix<double> m(rows.size(), rows.size() ? rows[0].size() : 0);
+    for (size_t i = 0; i < rows.size(); ++i)
+        std::copy(rows[i].begin(), rows[i].end(), m.row(i));
+    return m;
 }
 
 uint32_t
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "network.hpp"
+
+//
+//  Training allocates nothing after its first step: every buffer is a
+//  workspace of the network or its layers, or one brought by the caller,
+//  see network::train
+//  Built with BLAS_COUNT_ALLOCATIONS, run by ctest
+//
+
+template <typename Step>
+bool
+steady(const std::string& name, Step step)
+{
+    // the first step sizes the workspaces and grows the pool's queues
+    step();
+
+    const size_t before = blas::allocations();
+    for (int i = 0; i < 100; ++i)
+        step();
+    const size_t after = blas::allocations();
+
+    std::cout << name << ": " << after - before << " allocations in 100 steps" << std::endl;
+    return after == before;
+}
+
+template <typename T>
+bool
+check(const std::string& type)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<T> pixel(T(0), T(1));
+
+    blas::vector<T> input(784), target(10);
+    for (auto& x : input)
+        x = pixel(random) < T(0.8) ? T(0) : pixel(random);
+    target.fill(T(0));
+    target[3] = T(1);
+
+    blas::sparse_vector<T> sparse;
+    sparse.assign(input);
+
+    neural::network<T> dense_net(784, 128, 10);
+    neural::network<T> sparse_net(neural::sparse_input, 784, 128, 10);
+    neural::network<T> shared_net(784, 128, 10);
+
+    typename neural::network<T>::workspace work = shared_net.make_workspace();
+
+    bool ok = true;
+    ok = steady(type + " dense train", [&] { dense_net.train(input, target, T(0.1)); }) and ok;
+    ok = steady(type + " sparse train", [&] { sparse_net.train(sparse, target, T(0.1)); }) and ok;
+    ok = steady(type + " workspace train", [&] { shared_net.train(input, target, T(0.1), work); }) and ok;
+    return ok;
+}
+
+int main()
+{
+    bool ok = check<float>("float");
+    ok = check<double>("double") and ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "data_parallel_trainer.hpp"
+
+//
+//  data_parallel_trainer gives the same weights bit for bit whatever the
+//  number of threads in the pool, and steps like network::train_batch up to
+//  rounding: the slices only change the order of the sums
+//  Run by ctest
+//
+
+template <typename T>
+T
+distance(const neural::network<T>& a, const neural::network<T>& b)
+{
+    T largest = T(0);
+    for (size_t i = 0; i < a.layers().size(); ++i)
+    {
+        const auto& x = a.layers()[i];
+        const auto& y = b.layers()[i];
+
+        for (size_t k = 0; k < x.weights().size(); ++k)
+            largest = std::max(largest, std::fabs(x.weights().data()[k] - y.weights().data()[k]));
+        for (size_t k = 0; k < x.bias().size(); ++k)
+            largest = std::max(largest, std::fabs(x.bias()[k] - y.bias()[k]));
+    }
+    return largest;
+}
+
+template <typename T>
+bool
+same(const neural::network<T>& a, const neural::network<T>& b)
+{
+    for (size_t i = 0; i < a.layers().size(); ++i)
+    {
+        const auto& x = a.layers()[i];
+        const auto& y = b.layers()[i];
+
+        if (std::memcmp(x.weights().data(), y.weights().data(), x.weights().size() * sizeof(T)) != 0 or
+            std::memcmp(x.bias().data(), y.bias().data(), x.bias().size() * sizeof(T)) != 0)
+            return false;
+    }
+    return true;
+}
+
+template <typename T>
+void
+train(neural::network<T>& net, size_t threads, const blas::matrix<T>& inputs, const blas::matrix<T>& targets)
+{
+    blas::set_num_threads(threads);
+
+    neural::data_parallel_trainer<T> trainer(net, 4);
+    for (int step = 0; step < 3; ++step)
+        trainer.train_batch(inputs.view(), targets.view(), T(0.1));
+}
+
+template <typename T>
+bool
+check(const std::string& type)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<T> value(T(-1), T(1));
+
+    blas::matrix<T> inputs(96, 100), targets(96, 10);
+    for (auto& x : inputs) x = value(random);
+    for (auto& x : targets) x = value(random);
+
+    const neural::network<T> net(100, 64, 10);
+
+    neural::network<T> serial = net;
+    train(serial, 1, inputs, targets);
+
+    neural::network<T> pooled = net;
+    train(pooled, 4, inputs, targets);
+
+    neural::network<T> reference = net;
+    for (int step = 0; step < 3; ++step)
+        reference.train_batch(inputs.view(), targets.view(), T(0.1));
+
+    const bool deterministic = same(serial, pooled);
+    const bool close = distance(serial, reference) < (sizeof(T) == 4 ? T(1e-4) : T(1e-12));
+
+    std::cout << type << " 1 and 4 threads: " << (deterministic ? "identical" : "DIFFERENT") << std::endl;
+    std::cout << type << " against train_batch: " << (close ? "ok" : "FAILED")
+              << " (" << distance(serial, reference) << ")" << std::endl;
+    return deterministic and close;
+}
+
+int main()
+{
+    bool ok = check<float>("float");
+    ok = check<double>("double") and ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "blas/gemm.hpp"
+
+//
+//  The packed GEMM engine against a naive triple loop, on sizes that leave
+//  partial register tiles and cache blocks on every edge, with leading
+//  dimensions wider than the operands, at every dispatch level the host
+//  supports since each has its own register tile
+//  Run by ctest
+//
+
+template <typename T>
+bool
+compare(size_t m, size_t n, size_t k, T beta)
+{
+    std::mt19937 random(static_cast<unsigned>(m * 131 + n * 17 + k));
+    std::uniform_real_distribution<T> value(T(-1), T(1));
+
+    const size_t lda = k + 3, ldb = n + 1, ldc = n + 5;
+
+    std::vector<T> a(m * lda), b(k * ldb), c(m * ldc);
+    for (auto& x : a) x = value(random);
+    for (auto& x : b) x = value(random);
+    for (auto& x : c) x = value(random);
+
+    // reference, accumulated in double
+    std::vector<double> expected(m * ldc);
+    for (size_t i = 0; i < m; ++i)
+    {
+        for (size_t j = 0; j < ldc; ++j)
+        {
+            if (j >= n)
+            {
+                expected[i * ldc + j] = c[i * ldc + j];
+                continue;
+            }
+
+            double sum = double(beta) * c[i * ldc + j];
+            for (size_t p = 0; p < k; ++p)
+                sum += double(a[i * lda + p]) * b[p * ldb + j];
+            expected[i * ldc + j] = sum;
+        }
+    }
+
+    blas::kernel::gemm(m, n, k, a.data(), lda, b.data(), ldb, beta, c.data(), ldc);
+
+    // every term is below 1 in magnitude
+    const double tolerance = (sizeof(T) == 4 ? 1e-5 : 1e-13) * (k + 1);
+
+    for (size_t i = 0; i < m * ldc; ++i)
+    {
+        // padding past n columns must be left alone
+        const bool padding = i % ldc >= n;
+
+        if (padding ? c[i] != T(expected[i]) : std::fabs(c[i] - expected[i]) > tolerance)
+        {
+            std::cout << "  " << m << " x " << n << " x " << k << ", beta " << beta
+                      << ": C(" << i / ldc << ", " << i % ldc << ") is " << c[i]
+                      << ", expected " << expected[i] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename T>
+bool
+check(const std::string& type)
+{
+    static const size_t sizes[][3] =
+    {
+        { 1, 1, 1 }, { 3, 5, 7 }, { 17, 1, 33 }, { 1, 65, 19 },
+        { 33, 35, 31 }, { 97, 83, 61 }, { 131, 129, 257 }, { 250, 37, 513 },
+        { 7, 2051, 9 }, { 15, 97, 300 }, { 29, 47, 45 }
+    };
+
+    bool ok = true;
+    for (const auto& s : sizes)
+    {
+        ok = compare<T>(s[0], s[1], s[2], T(0)) and ok;
+        ok = compare<T>(s[0], s[1], s[2], T(0.5)) and ok;
+    }
+
+    std::cout << type << " gemm: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    for (int level = 0; level <= int(blas::cpu::best_isa()); ++level)
+    {
+        blas::cpu::set_isa(blas::cpu::isa(level));
+
+        const std::string name = blas::cpu::isa_name(blas::cpu::active_isa());
+        ok = check<float>(name + " float") and ok;
+        ok = check<double>(name + " double") and ok;
+    }
+    return ok ? 0 : 1;
+}
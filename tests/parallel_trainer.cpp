@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "parallel_trainer.hpp"
+
+//
+//  parallel_trainer with a single thread trains exactly as network::train
+//  does on the same order of samples: the shared kernels are the ordinary
+//  ones, so the weights must match bit for bit, dense and sparse inputs,
+//  either storage order of the first layer
+//  Run by ctest, also with a pool of several threads
+//
+
+template <typename T>
+bool
+same(const neural::network<T>& a, const neural::network<T>& b)
+{
+    for (size_t i = 0; i < a.layers().size(); ++i)
+    {
+        const auto& x = a.layers()[i];
+        const auto& y = b.layers()[i];
+
+        if (std::memcmp(x.weights().data(), y.weights().data(), x.weights().size() * sizeof(T)) != 0 or
+            std::memcmp(x.bias().data(), y.bias().data(), x.bias().size() * sizeof(T)) != 0)
+            return false;
+    }
+    return true;
+}
+
+template <typename T, typename _input>
+bool
+compare(const std::string& name, neural::network<T> net, const blas::vector<_input>& inputs, const blas::vector<blas::vector<T>>& targets)
+{
+    const unsigned seed = 7;
+    const T learning_rate = T(0.01);
+
+    neural::network<T> reference = net;
+
+    neural::parallel_trainer<T> trainer(net, 1, seed);
+
+    // the trainer's shuffle, replayed
+    std::mt19937 random(seed);
+    blas::vector<size_t> order(inputs.size());
+
+    for (int epoch = 0; epoch < 2; ++epoch)
+    {
+        trainer.train(inputs, targets, learning_rate);
+
+        for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), random);
+
+        for (size_t i : order)
+            reference.train(inputs[i], targets[i], learning_rate);
+    }
+
+    const bool ok = same(net, reference);
+    std::cout << name << ": " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+template <typename T>
+bool
+check(const std::string& type)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<T> pixel(T(0), T(1));
+
+    blas::vector<blas::vector<T>> inputs(64);
+    blas::vector<blas::sparse_vector<T>> sparse_inputs(64);
+    blas::vector<blas::vector<T>> targets(64);
+
+    for (size_t s = 0; s < inputs.size(); ++s)
+    {
+        inputs[s].resize(100);
+        for (auto& x : inputs[s])
+            x = pixel(random) < T(0.8) ? T(0) : pixel(random);
+        sparse_inputs[s].assign(inputs[s]);
+
+        targets[s].resize(10);
+        targets[s].fill(T(0));
+        targets[s][s % 10] = T(1);
+    }
+
+    neural::network<T> dense_net(100, 32, 10);
+    neural::network<T> sparse_net(neural::sparse_input, 100, 32, 10);
+
+    bool ok = true;
+    ok = compare(type + " dense", dense_net, inputs, targets) and ok;
+    ok = compare(type + " sparse, output major", dense_net, sparse_inputs, targets) and ok;
+    ok = compare(type + " sparse, input major", sparse_net, sparse_inputs, targets) and ok;
+    return ok;
+}
+
+int main()
+{
+    bool ok = check<float>("float");
+    ok = check<double>("double") and ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "pipeline_trainer.hpp"
+
+//
+//  pipeline_trainer with one sample in flight trains exactly as
+//  network::train does over the same samples, and its feed_forward gives
+//  the outputs of network::feed_forward, bit for bit; several runs reuse the
+//  stage threads
+//  Run by ctest
+//
+
+template <typename T>
+bool
+same(const neural::network<T>& a, const neural::network<T>& b)
+{
+    for (size_t i = 0; i < a.layers().size(); ++i)
+    {
+        const auto& x = a.layers()[i];
+        const auto& y = b.layers()[i];
+
+        if (std::memcmp(x.weights().data(), y.weights().data(), x.weights().size() * sizeof(T)) != 0 or
+            std::memcmp(x.bias().data(), y.bias().data(), x.bias().size() * sizeof(T)) != 0)
+            return false;
+    }
+    return true;
+}
+
+template <typename T, typename _input>
+bool
+compare(const std::string& name, neural::network<T> net, const blas::vector<_input>& inputs, const blas::vector<blas::vector<T>>& targets)
+{
+    const T learning_rate = T(0.01);
+
+    neural::network<T> reference = net;
+
+    // trained one sample at a time
+    neural::pipeline_trainer<T> trainer(net, 1);
+    for (int epoch = 0; epoch < 2; ++epoch)
+    {
+        trainer.train(inputs, targets, learning_rate);
+
+        for (size_t i = 0; i < inputs.size(); ++i)
+            reference.train(inputs[i], targets[i], learning_rate);
+    }
+
+    bool trained = same(net, reference);
+
+    // and the outputs of the trained network, with the pipeline full
+    neural::pipeline_trainer<T> pipeline(net);
+
+    blas::vector<blas::vector<T>> outputs;
+    pipeline.feed_forward(inputs, outputs);
+
+    bool forward = true;
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        const auto& expected = reference.feed_forward(inputs[i]);
+        forward = forward and outputs[i].size() == expected.size() and
+            std::memcmp(outputs[i].data(), expected.data(), expected.size() * sizeof(T)) == 0;
+    }
+
+    // staleness changes the weights with more in flight, but every sample
+    // must still come back
+    pipeline.train(inputs, targets, learning_rate);
+
+    std::cout << name << " train: " << (trained ? "ok" : "FAILED") << std::endl;
+    std::cout << name << " feed_forward: " << (forward ? "ok" : "FAILED") << std::endl;
+    return trained and forward;
+}
+
+template <typename T>
+bool
+check(const std::string& type)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<T> pixel(T(0), T(1));
+
+    blas::vector<blas::vector<T>> inputs(64);
+    blas::vector<blas::sparse_vector<T>> sparse_inputs(64);
+    blas::vector<blas::vector<T>> targets(64);
+
+    for (size_t s = 0; s < inputs.size(); ++s)
+    {
+        inputs[s].resize(100);
+        for (auto& x : inputs[s])
+            x = pixel(random) < T(0.8) ? T(0) : pixel(random);
+        sparse_inputs[s].assign(inputs[s]);
+
+        targets[s].resize(10);
+        targets[s].fill(T(0));
+        targets[s][s % 10] = T(1);
+    }
+
+    neural::network<T> deep_net(100, 48, 32, 24, 10);
+    neural::network<T> single_net(100, 10);
+
+    bool ok = true;
+    ok = compare(type + " dense", deep_net, inputs, targets) and ok;
+    ok = compare(type + " sparse", deep_net, sparse_inputs, targets) and ok;
+    ok = compare(type + " single layer", single_net, inputs, targets) and ok;
+    return ok;
+}
+
+int main()
+{
+    bool ok = check<float>("float");
+    ok = check<double>("double") and ok;
+    return ok ? 0 : 1;
+}
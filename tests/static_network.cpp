@@ -0,0 +1,87 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "network.hpp"
+#include "static_network.hpp"
+
+//
+//  static_network against network on the same weights: the outputs and the
+//  weights after training must agree up to rounding, the fixed-shape
+//  kernels only change the order of some sums
+//  Run by ctest
+//
+
+template <typename A, typename B>
+double
+distance(const A& a, const B& b, size_t size)
+{
+    double largest = 0.0;
+    for (size_t i = 0; i < size; ++i)
+        largest = std::max(largest, std::fabs(double(a.data()[i]) - double(b.data()[i])));
+    return largest;
+}
+
+template <typename Static, typename T>
+double
+distance(const Static& fixed, const neural::network<T>& net)
+{
+    const auto& first = std::get<0>(fixed.layers());
+    const auto& second = std::get<1>(fixed.layers());
+
+    return std::max({
+        distance(first.weights(), net.layers()[0].output_major_weights(), first.weights().size()),
+        distance(first.bias(), net.layers()[0].bias(), first.bias().size()),
+        distance(second.weights(), net.layers()[1].output_major_weights(), second.weights().size()),
+        distance(second.bias(), net.layers()[1].bias(), second.bias().size())
+    });
+}
+
+template <typename T>
+bool
+check(const std::string& type, double tolerance)
+{
+    typedef neural::basic_static_network<T, 784, 128, 10> static_type;
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<T> pixel(T(0), T(1));
+
+    neural::network<T> net(784, 128, 10);
+
+    // too large for the stack
+    std::unique_ptr<static_type> fixed(new static_type);
+    std::get<0>(fixed->layers()).assign(net.layers()[0].output_major_weights(), net.layers()[0].bias());
+    std::get<1>(fixed->layers()).assign(net.layers()[1].output_major_weights(), net.layers()[1].bias());
+
+    blas::vector<T> input(784), target(10);
+    double outputs = 0.0;
+
+    for (int step = 0; step < 20; ++step)
+    {
+        for (auto& x : input)
+            x = pixel(random) < T(0.8) ? T(0) : pixel(random);
+        target.fill(T(0));
+        target[step % 10] = T(1);
+
+        outputs = std::max(outputs, distance(fixed->feed_forward(input), net.feed_forward(input), 10));
+
+        fixed->train(input, target, T(0.01));
+        net.train(input, target, T(0.01));
+    }
+
+    const double weights = distance(*fixed, net);
+
+    const bool ok = outputs < tolerance and weights < tolerance;
+    std::cout << type << " static_network<784, 128, 10>: " << (ok ? "ok" : "FAILED")
+              << " (outputs " << outputs << ", weights " << weights << ")" << std::endl;
+    return ok;
+}
+
+int main()
+{
+    bool ok = check<float>("float", 1e-4);
+    ok = check<double>("double", 1e-12) and ok;
+    return ok ? 0 : 1;
+}